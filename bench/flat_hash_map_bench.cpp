@@ -0,0 +1,168 @@
+// (c) 2023 Copyright, Real-Time Innovations, Inc.  All rights reserved.
+//
+// RTI grants Licensee a license to use, modify, compile, and create derivative
+// works of the Software.  Licensee has the right to distribute object form
+// only for use with RTI products.  The Software is provided "as is", with no
+// warranty of any type, including any warranty for fitness for any purpose.
+// RTI is under no obligation to maintain or support the Software.  RTI shall
+// not be liable for any incidental or consequential damages arising out of the
+// use or inability to use the software.
+
+// Compare FlatHashMap with std::unordered_map for the key types used by
+// the TypeCache indexes: interned name ids (NameId), and type names looked
+// up by std::string_view. Both maps are filled with the same entries and
+// must agree on every lookup, otherwise the program exits with an error.
+//
+// Usage: robotspy_flat_hash_map_bench [KEY-COUNT]
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "robotspy/flat_hash_map.hpp"
+#include "robotspy/name_interner.hpp"
+
+using namespace robotspy;
+
+// Lookups per key, half of them for keys which are not in the map.
+static const size_t LOOKUP_ROUNDS = 10;
+
+template<typename Fn>
+static
+double
+time_per_op(const size_t ops, Fn && fn)
+{
+  const auto start = std::chrono::steady_clock::now();
+  fn();
+  const auto elapsed = std::chrono::steady_clock::now() - start;
+  return std::chrono::duration<double, std::nano>(elapsed).count() / ops;
+}
+
+static
+void
+report(
+  const char * const label,
+  const double flat_insert, const double std_insert,
+  const double flat_find, const double std_find)
+{
+  std::cout << label << ": insert " << flat_insert << " ns (FlatHashMap), "
+            << std_insert << " ns (std::unordered_map); find "
+            << flat_find << " ns (FlatHashMap), "
+            << std_find << " ns (std::unordered_map)" << std::endl;
+}
+
+static
+bool
+bench_name_ids(const size_t count)
+{
+  // Interned ids are dense, but only a subset of them is cached.
+  std::mt19937 rng(1);
+  std::vector<NameId> keys;
+  std::vector<NameId> lookups;
+  keys.reserve(count);
+  for (size_t i = 0; i < count; i++) {
+    keys.push_back(static_cast<NameId>(i * 2));
+  }
+  for (size_t i = 0; i < count * LOOKUP_ROUNDS; i++) {
+    lookups.push_back(static_cast<NameId>(rng() % (count * 2)));
+  }
+
+  FlatHashMap<NameId, size_t> flat_map;
+  std::unordered_map<NameId, size_t> std_map;
+  const double flat_insert = time_per_op(count, [&flat_map, &keys]() {
+        for (size_t i = 0; i < keys.size(); i++) {
+          flat_map.emplace(keys[i], i);
+        }
+      });
+  const double std_insert = time_per_op(count, [&std_map, &keys]() {
+        for (size_t i = 0; i < keys.size(); i++) {
+          std_map.emplace(keys[i], i);
+        }
+      });
+  size_t flat_sum = 0;
+  size_t std_sum = 0;
+  const double flat_find = time_per_op(lookups.size(), [&flat_map, &lookups, &flat_sum]() {
+        for (const auto & key : lookups) {
+          const size_t * const value = flat_map.find(key);
+          flat_sum += (nullptr != value) ? *value + 1 : 0;
+        }
+      });
+  const double std_find = time_per_op(lookups.size(), [&std_map, &lookups, &std_sum]() {
+        for (const auto & key : lookups) {
+          const auto value = std_map.find(key);
+          std_sum += (std_map.end() != value) ? value->second + 1 : 0;
+        }
+      });
+  report("NameId keys", flat_insert, std_insert, flat_find, std_find);
+  return flat_map.size() == std_map.size() && flat_sum == std_sum;
+}
+
+static
+bool
+bench_type_names(const size_t count)
+{
+  std::mt19937 rng(2);
+  std::vector<std::string> keys;
+  std::vector<std::string> lookups;
+  keys.reserve(count);
+  for (size_t i = 0; i < count; i++) {
+    keys.push_back(
+      "package_" + std::to_string(i % 100) + "_msgs::msg::dds_::Type" + std::to_string(i) + "_");
+  }
+  for (size_t i = 0; i < count * LOOKUP_ROUNDS; i++) {
+    const size_t key = rng() % (count * 2);
+    lookups.push_back(
+      "package_" + std::to_string(key % 100) + "_msgs::msg::dds_::Type" + std::to_string(key) +
+      "_");
+  }
+
+  // As in TypeCache, std::unordered_map can't be queried with a
+  // std::string_view without building a std::string (before C++20).
+  FlatHashMap<std::string, size_t, StringHash> flat_map;
+  std::unordered_map<std::string, size_t> std_map;
+  const double flat_insert = time_per_op(count, [&flat_map, &keys]() {
+        for (size_t i = 0; i < keys.size(); i++) {
+          flat_map.emplace(std::string_view(keys[i]), i);
+        }
+      });
+  const double std_insert = time_per_op(count, [&std_map, &keys]() {
+        for (size_t i = 0; i < keys.size(); i++) {
+          std_map.emplace(keys[i], i);
+        }
+      });
+  size_t flat_sum = 0;
+  size_t std_sum = 0;
+  const double flat_find = time_per_op(lookups.size(), [&flat_map, &lookups, &flat_sum]() {
+        for (const auto & key : lookups) {
+          const size_t * const value = flat_map.find(std::string_view(key));
+          flat_sum += (nullptr != value) ? *value + 1 : 0;
+        }
+      });
+  const double std_find = time_per_op(lookups.size(), [&std_map, &lookups, &std_sum]() {
+        for (const auto & key : lookups) {
+          const std::string_view key_view(key);
+          const auto value = std_map.find(std::string(key_view));
+          std_sum += (std_map.end() != value) ? value->second + 1 : 0;
+        }
+      });
+  report("type name keys", flat_insert, std_insert, flat_find, std_find);
+  return flat_map.size() == std_map.size() && flat_sum == std_sum;
+}
+
+int main(int argc, const char ** const argv)
+{
+  size_t count = 100000;
+  if (argc > 1) {
+    count = std::stoul(argv[1]);
+  }
+  bool ok = bench_name_ids(count);
+  ok = bench_type_names(count) && ok;
+  if (!ok) {
+    std::cerr << "FlatHashMap and std::unordered_map returned different results" << std::endl;
+    return 1;
+  }
+  return 0;
+}
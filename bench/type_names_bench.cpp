@@ -0,0 +1,347 @@
+// (c) 2023 Copyright, Real-Time Innovations, Inc.  All rights reserved.
+//
+// RTI grants Licensee a license to use, modify, compile, and create derivative
+// works of the Software.  Licensee has the right to distribute object form
+// only for use with RTI products.  The Software is provided "as is", with no
+// warranty of any type, including any warranty for fitness for any purpose.
+// RTI is under no obligation to maintain or support the Software.  RTI shall
+// not be liable for any incidental or consequential damages arising out of the
+// use or inability to use the software.
+
+// Check that the type name helpers in typesupport.hpp return the same
+// results as the regex-based implementations that they replaced, on
+// NAME-COUNT randomly generated names and NAME-COUNT well-formed ROS type
+// names, then compare the time spent by each implementation on the
+// well-formed names. Exits with an error if any result differs.
+//
+// Usage: robotspy_type_names_bench [NAME-COUNT]
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <regex>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "robotspy/typesupport.hpp"
+
+using namespace robotspy;
+
+// The regex-based implementations replaced by the string scanning ones.
+namespace regex_reference
+{
+std::string
+normalize_dds_type_name(const std::string & type_fqname)
+{
+  const static std::regex double_underscore_re("__");
+  const static std::regex trail_underscore_re("_$");
+  const static std::regex dds_ns_re("::dds_::");
+  const static std::regex dds_ns_rm_re("::dds::");
+  if (type_fqname.size() == 0) {
+    throw std::runtime_error("empty type name");
+  }
+  return
+    std::regex_replace(
+    std::regex_replace(
+      std::regex_replace(
+        std::regex_replace(
+          type_fqname,
+          double_underscore_re, "::"),
+        trail_underscore_re, ""),
+      dds_ns_re, "::dds::"),
+    dds_ns_rm_re, "::");
+}
+
+const std::tuple<std::string, std::string, std::string>
+parse_ros_type_name(const std::string & type_fqname)
+{
+  const static std::regex double_underscore_re("__");
+  const static std::regex trail_underscore_re("_$");
+  std::string norm_fqname =
+    std::regex_replace(
+    std::regex_replace(type_fqname, double_underscore_re, "/"),
+    trail_underscore_re, "");
+  static const char type_separator = '/';
+  auto sep_position_back = norm_fqname.find_last_of(type_separator);
+  auto sep_position_front = norm_fqname.find_first_of(type_separator);
+  if (sep_position_back == std::string::npos ||
+    sep_position_back == 0 ||
+    sep_position_back == norm_fqname.length() - 1)
+  {
+    throw InvalidTopicNameException(
+            std::string("invalid ROS 2 type name: ") + type_fqname);
+  }
+
+  std::string package_name = type_fqname.substr(0, sep_position_front);
+  std::string middle_module = "";
+  if (sep_position_back - sep_position_front > 0) {
+    middle_module =
+      type_fqname.substr(sep_position_front + 1, sep_position_back - sep_position_front - 1);
+  }
+  std::string type_name = type_fqname.substr(sep_position_back + 1);
+
+  return std::make_tuple(package_name, middle_module, type_name);
+}
+
+std::string
+demangle_dds_type_name(const std::string & dds_type_name)
+{
+  size_t ns_count = 0;
+  size_t ns_sep_pos = dds_type_name.find("::");
+  size_t first_sep_pos = std::string::npos;
+  while (ns_sep_pos != std::string::npos) {
+    if (ns_count == 0) {
+      first_sep_pos = ns_sep_pos;
+    }
+    ns_count += 1;
+    ns_sep_pos = dds_type_name.find("::", ns_sep_pos + 2);
+  }
+  if (ns_count == 2 &&
+    (0 == strncmp(dds_type_name.c_str() + first_sep_pos, "::msg::", 7) ||
+    0 == strncmp(dds_type_name.c_str() + first_sep_pos, "::srv::", 7)))
+  {
+    return std::regex_replace(dds_type_name, std::regex("::"), "/");
+  }
+
+  size_t dds_prefix_len = 8;
+  auto dds_prefix_pos = dds_type_name.rfind("::dds_::");
+  if (dds_prefix_pos == std::string::npos) {
+    dds_prefix_len -= 1;
+    dds_prefix_pos = dds_type_name.rfind("::dds::");
+    if (dds_prefix_pos == std::string::npos) {
+      throw InvalidTopicNameException(
+              std::string("invalid ROS 2 DDS type name 1: ") + dds_type_name);
+    }
+  }
+  if (dds_type_name.rfind("::") != (dds_prefix_pos + dds_prefix_len - 2)) {
+    throw InvalidTopicNameException(
+            std::string("invalid ROS 2 DDS type name 2: ") + dds_type_name);
+  }
+
+  auto type_name = dds_type_name.substr(dds_prefix_pos + dds_prefix_len);
+  if (type_name[type_name.size() - 1] == '_') {
+    type_name = type_name.substr(0, type_name.size() - 1);
+  }
+
+  std::ostringstream ss;
+  size_t search_start = 0;
+  size_t sep_pos;
+  do {
+    sep_pos = dds_type_name.find("::", search_start);
+    if (search_start > 0) {
+      ss << "/";
+    }
+    auto el = dds_type_name.substr(search_start, sep_pos - search_start);
+    ss << el;
+    search_start += el.size() + 2;
+    sep_pos = dds_type_name.find("::", search_start);
+  } while (sep_pos <= dds_prefix_pos);
+  ss << "/" << type_name;
+  return ss.str();
+}
+}  // namespace regex_reference
+
+// Generate names out of tokens which exercise all the separators handled
+// by the type name helpers.
+static
+std::vector<std::string>
+generate_names(const size_t count)
+{
+  static const char * const tokens[] = {
+    "a", "b", "std_msgs", "msg", "srv", "dds", "dds_", "::", "__", "_", "/",
+    "Request", "Response", "Type", ":"
+  };
+  static const size_t tokens_count = sizeof(tokens) / sizeof(tokens[0]);
+  std::mt19937 rng(1);
+  std::vector<std::string> names;
+  names.reserve(count);
+  for (size_t i = 0; i < count; i++) {
+    std::string name;
+    const size_t name_tokens = rng() % 8;
+    for (size_t t = 0; t < name_tokens; t++) {
+      name += tokens[rng() % tokens_count];
+    }
+    names.emplace_back(std::move(name));
+  }
+  return names;
+}
+
+// Generate names in the forms that are actually encountered, e.g.
+// "pkg::msg::dds_::Type_", "pkg::srv::Type_Request", or "pkg/msg/Type".
+static
+std::vector<std::string>
+generate_ros_names(const size_t count)
+{
+  static const char * const forms[] = {
+    "%s::%s::dds_::%s_", "%s::%s::dds::%s", "%s::%s::%s", "%s/%s/%s"
+  };
+  static const char * const modules[] = {"msg", "srv"};
+  static const char * const suffixes[] = {"", "Request", "Response"};
+  std::mt19937 rng(2);
+  std::vector<std::string> names;
+  names.reserve(count);
+  char name[256];
+  for (size_t i = 0; i < count; i++) {
+    const std::string package = "package_" + std::to_string(rng() % 100) + "_msgs";
+    const char * const module = modules[rng() % 2];
+    std::string type = "Type" + std::to_string(rng() % 1000);
+    if (0 == strcmp(module, "srv")) {
+      type += suffixes[1 + rng() % 2];
+    }
+    snprintf(name, sizeof(name), forms[rng() % 4], package.c_str(), module, type.c_str());
+    names.emplace_back(name);
+  }
+  return names;
+}
+
+// Call fn and return its result, or a marker for the exception it threw.
+template<typename Fn>
+static
+std::string
+result_or_error(Fn && fn)
+{
+  try {
+    return fn();
+  } catch (InvalidTopicNameException &) {
+    return "<invalid name>";
+  } catch (std::exception &) {
+    return "<error>";
+  }
+}
+
+static
+std::string
+join_parsed(const std::tuple<std::string, std::string, std::string> & parsed)
+{
+  return std::get<0>(parsed) + "|" + std::get<1>(parsed) + "|" + std::get<2>(parsed);
+}
+
+static
+bool
+ends_with(const std::string & str, const char * const suffix)
+{
+  const size_t suffix_len = strlen(suffix);
+  return str.size() >= suffix_len &&
+         0 == str.compare(str.size() - suffix_len, suffix_len, suffix);
+}
+
+static
+size_t
+check_name(const std::string & name)
+{
+  size_t mismatches = 0;
+  auto report = [&mismatches, &name](
+    const char * const fn_name, const std::string & expected, const std::string & actual)
+    {
+      if (expected != actual) {
+        if (mismatches++ == 0) {
+          std::cerr << "mismatch for \"" << name << "\":" << std::endl;
+        }
+        std::cerr << "  " << fn_name << ": expected \"" << expected
+                  << "\", got \"" << actual << "\"" << std::endl;
+      }
+    };
+
+  report("normalize_dds_type_name",
+    result_or_error([&name]() {return regex_reference::normalize_dds_type_name(name);}),
+    result_or_error([&name]() {return normalize_dds_type_name(name);}));
+
+  // The regex implementation splits ":::" inconsistently, which the new one
+  // doesn't try to reproduce.
+  if (name.find(":::") == std::string::npos) {
+    report("demangle_dds_type_name",
+      result_or_error([&name]() {return regex_reference::demangle_dds_type_name(name);}),
+      result_or_error([&name]() {return demangle_dds_type_name(name);}));
+  }
+
+  // The regex implementation returned components which still contained
+  // "__" separators; parse_ros_type_name() now splits them.
+  if (name.find("__") == std::string::npos) {
+    report("parse_ros_type_name",
+      result_or_error(
+        [&name]() {return join_parsed(regex_reference::parse_ros_type_name(name));}),
+      result_or_error([&name]() {return join_parsed(parse_ros_type_name(name));}));
+  }
+
+  // The rfind()-based implementation misreported short names and names
+  // with more than one suffix, so compare with the plain suffix checks.
+  const bool request = ends_with(name, "Request") || ends_with(name, "Request_");
+  const bool reply = ends_with(name, "Response") || ends_with(name, "Response_");
+  const auto requestreply = is_type_requestreply(name);
+  report("is_type_requestreply",
+    std::to_string(request || reply) + std::to_string(request),
+    std::to_string(requestreply.first) + std::to_string(requestreply.second));
+  return mismatches;
+}
+
+template<typename Fn>
+static
+double
+time_per_name(const std::vector<std::string> & names, Fn && fn)
+{
+  const auto start = std::chrono::steady_clock::now();
+  for (const auto & name : names) {
+    try {
+      fn(name);
+    } catch (std::exception &) {
+    }
+  }
+  const auto elapsed = std::chrono::steady_clock::now() - start;
+  return std::chrono::duration<double, std::nano>(elapsed).count() / names.size();
+}
+
+int main(int argc, const char ** const argv)
+{
+  size_t count = 300000;
+  if (argc > 1) {
+    count = std::stoul(argv[1]);
+  }
+  auto names = generate_names(count);
+  const auto ros_names = generate_ros_names(count);
+  names.insert(names.end(), ros_names.begin(), ros_names.end());
+
+  size_t failed = 0;
+  for (const auto & name : names) {
+    if (check_name(name) > 0) {
+      failed += 1;
+    }
+  }
+  std::cout << names.size() << " names checked, " << failed << " mismatches" << std::endl;
+
+  // Only time valid inputs for each function, so that the cost of throwing
+  // exceptions doesn't hide the cost of the scans.
+  std::vector<std::string> dds_names;
+  std::vector<std::string> slash_names;
+  for (const auto & name : ros_names) {
+    if (name.find('/') == std::string::npos) {
+      dds_names.push_back(name);
+      slash_names.push_back(demangle_dds_type_name(name));
+    }
+  }
+  std::cout << "normalize_dds_type_name: "
+            << time_per_name(dds_names, [](const std::string & name) {
+       return regex_reference::normalize_dds_type_name(name);
+     }) << " ns/name (regex), "
+            << time_per_name(dds_names, [](const std::string & name) {
+       return normalize_dds_type_name(name);
+     }) << " ns/name" << std::endl;
+  std::cout << "demangle_dds_type_name: "
+            << time_per_name(dds_names, [](const std::string & name) {
+       return regex_reference::demangle_dds_type_name(name);
+     }) << " ns/name (regex), "
+            << time_per_name(dds_names, [](const std::string & name) {
+       return demangle_dds_type_name(name);
+     }) << " ns/name" << std::endl;
+  std::cout << "parse_ros_type_name: "
+            << time_per_name(slash_names, [](const std::string & name) {
+       return regex_reference::parse_ros_type_name(name);
+     }) << " ns/name (regex), "
+            << time_per_name(slash_names, [](const std::string & name) {
+       return parse_ros_type_name(name);
+     }) << " ns/name" << std::endl;
+
+  return (failed > 0) ? 1 : 0;
+}
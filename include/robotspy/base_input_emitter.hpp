@@ -13,25 +13,78 @@
 #include <iostream>
 #include <fstream>
 #include <string>
+#include <string_view>
+#include <memory>
+#include <utility>
 #include <mutex>
 #include <regex>
 #include <atomic>
 #include <condition_variable>
 #include <chrono>
-#include <deque>
 #include <thread>
 #include <tuple>
+#include <unordered_map>
+#include <algorithm>
+#include <cctype>
 
 #include "dds/dds.hpp"
 
 #include "robotspy/input_emitter.hpp"
+#include "robotspy/input_ring.hpp"
+#include "robotspy/mapped_file.hpp"
 
 namespace robotspy
 {
 
+// What to do with a new input record when the input queue is full.
+enum class InputOverflowPolicy
+{
+  // Wait until the consumer makes room in the queue.
+  Block,
+  // Drop the record if another one with the same type and topic is already
+  // queued, otherwise wait. Records are keyed by type and topic (rather than
+  // only by type), so that the topics of a type are never lost. Only the
+  // records queued while the queue is at least half full are considered.
+  Coalesce,
+  // Drop the record.
+  Drop
+};
+
+inline
+InputOverflowPolicy
+input_overflow_policy_from_string(const std::string & policy)
+{
+  std::string lowercase = policy;
+  std::transform(
+    lowercase.begin(), lowercase.end(), lowercase.begin(),
+    [](const unsigned char c) {return std::tolower(c);});
+  if (lowercase == "block" || lowercase == "b") {
+    return InputOverflowPolicy::Block;
+  } else if (lowercase == "coalesce" || lowercase == "c") {
+    return InputOverflowPolicy::Coalesce;
+  } else if (lowercase == "drop" || lowercase == "d") {
+    return InputOverflowPolicy::Drop;
+  } else {
+    throw std::runtime_error("invalid input overflow policy");
+  }
+}
+
 struct BaseInputEmitterOptions
 {
   std::vector<std::string> input_files;
+  // Maximum number of queued input records, rounded up to the next
+  // power of two by the input ring.
+  size_t queue_capacity{65536};
+  InputOverflowPolicy overflow_policy{InputOverflowPolicy::Block};
+};
+
+struct InputQueueStats
+{
+  size_t capacity{0};
+  size_t depth{0};
+  size_t peak_depth{0};
+  uint64_t dropped{0};
+  uint64_t coalesced{0};
 };
 
 class BaseInputEmitter : public InputEmitter
@@ -54,6 +107,23 @@ public:
   virtual
   std::tuple<std::string, std::string, DDS_TypeCode *>
   next();
+
+  virtual
+  size_t
+  next_batch(
+    std::vector<std::tuple<std::string, std::string, DDS_TypeCode *>> & batch,
+    const size_t max,
+    const std::chrono::milliseconds & timeout,
+    const bool block = false);
+
+  virtual
+  size_t
+  next_batch(
+    std::vector<std::tuple<std::string, std::string, DDS_TypeCode *>> & batch,
+    const size_t max);
+
+  InputQueueStats
+  queue_stats() const;
 protected:
   static
   void
@@ -61,23 +131,101 @@ protected:
 
   virtual void reader_thread_complete();
 
-  virtual void queue_input(
+  // Parse all memory-mapped input files, queueing their records in the
+  // order in which they appear in the input files.
+  void
+  read_mapped_inputs();
+
+  void
+  read_input_stream(const std::string & input_file, std::istream & input_stream);
+
+  // Queue the records of a buffer of newline-separated input lines.
+  void
+  parse_input_lines(const std::string_view & lines);
+
+  void
+  parse_input_line(const std::string_view & line);
+
+  // Returns false if the record was not queued (e.g. because it was dropped
+  // or coalesced by the overflow policy, or because the emitter was closed).
+  virtual bool queue_input(
     const std::string & topic_name,
     const std::string & type_name,
     const DDS_TypeCode * const type_tc = nullptr);
 
+  // Queue a record, moving its names into the queue.
+  bool
+  queue_input(
+    std::string && topic_name,
+    std::string && type_name,
+    const DDS_TypeCode * const type_tc = nullptr);
+
+  // Key used to coalesce records when the queue overflows ("type@topic").
+  static
+  std::string
+  coalesce_key(
+    const std::string & topic_name,
+    const std::string & type_name,
+    const DDS_TypeCode * const type_tc);
+
+  // Adjust the number of queued records with the specified coalescing key,
+  // and return the number before the update.
+  size_t
+  update_pending(const std::string & key, const bool increment);
+
+  bool
+  pop_input(std::tuple<std::string, std::string, DDS_TypeCode *> & next);
+
+  bool
+  wait_next_input(
+    std::tuple<std::string, std::string, DDS_TypeCode *> & next,
+    const std::chrono::milliseconds & timeout,
+    const bool block);
+
+  void
+  wait_for_input(
+    const std::chrono::steady_clock::time_point & deadline,
+    const bool block);
+
+  void
+  wake_input_waiters();
+
 private:
   const BaseInputEmitterOptions options_;
 
 protected:
-  std::vector<std::ifstream> input_files_;
-  std::map<std::string, std::istream *> input_streams_;
+  std::vector<std::unique_ptr<MappedFile>> input_maps_;
+  std::vector<std::unique_ptr<std::ifstream>> input_files_;
+  // Inputs which are not regular files (e.g. stdin, pipes), read serially
+  // in order after all mapped files.
+  std::vector<std::pair<std::string, std::istream *>> input_streams_;
   std::thread reader_thread_;
   std::atomic_bool active_{true};
   std::atomic_bool reader_thread_active_{true};
-  std::deque<std::tuple<std::string, std::string, DDS_TypeCode *>> input_queue_;
+  // A queued record, with the key it is counted under in input_pending_ (or
+  // an empty key if it isn't counted).
+  struct QueuedInput
+  {
+    std::tuple<std::string, std::string, DDS_TypeCode *> record;
+    std::string pending_key;
+  };
+  InputRing<QueuedInput> input_queue_;
+  // The mutex and condition variables are only used to park consumers while
+  // the queue is empty (and producers while it is full). Producers and
+  // consumers only take the mutex when the other side is waiting.
   std::mutex input_queue_mutex_;
   std::condition_variable input_queue_ready_;
+  std::condition_variable input_queue_space_;
+  std::atomic<uint32_t> input_consumers_waiting_{0};
+  std::atomic<uint32_t> input_producers_waiting_{0};
+  std::atomic<size_t> input_queue_peak_{0};
+  std::atomic<uint64_t> input_queue_dropped_{0};
+  std::atomic<uint64_t> input_queue_coalesced_{0};
+  // Only maintained by the Coalesce overflow policy, for the records queued
+  // while the queue is at least half full, so that producers and consumers
+  // don't contend on it until the queue might overflow.
+  std::unordered_map<std::string, size_t> input_pending_;
+  std::mutex input_pending_mutex_;
 };
 }  // namespace robotspy
 #endif  // ROBOTSPY__BASE_INPUT_EMITTER_HPP_
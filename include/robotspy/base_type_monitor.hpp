@@ -10,12 +10,20 @@
 #ifndef ROBOTSPY__BASE_TYPE_MONITOR_HPP_
 #define ROBOTSPY__BASE_TYPE_MONITOR_HPP_
 
-#include <regex>
 #include <atomic>
+#include <condition_variable>
+#include <map>
+#include <set>
+#include <shared_mutex>
+#include <thread>
+#include <vector>
 
 #include "dds/dds.hpp"
 
+#include "robotspy/flat_hash_map.hpp"
+#include "robotspy/name_interner.hpp"
 #include "robotspy/typecache.hpp"
+#include "robotspy/type_filter.hpp"
 #include "robotspy/output_emitter.hpp"
 #include "robotspy/input_emitter.hpp"
 
@@ -26,6 +34,18 @@ struct BaseTypeMonitorOptions
   bool include_non_ros{true};
   std::string type_filter{{".*"}};
   std::string raw_type_filter{{".*"}};
+  size_t input_batch_size{64};
+  // Number of threads processing input records.
+  size_t workers{1};
+  // Emit output in the same order as the input records were received,
+  // even when multiple workers are used.
+  bool ordered_output{false};
+  // If set, the IDL of all detected types is written to this file on exit.
+  std::string idl_file;
+  // Load all the ROS types installed in the ament index into the cache, on
+  // background threads, while input is being processed.
+  bool preload{false};
+  size_t preload_threads{2};
   TypeCacheOptions cache;
 };
 
@@ -68,15 +88,59 @@ public:
   on_topic_detected(const std::string & topic_name, const DDS_TypeCode * const tc);
 
 protected:
+  // Output generated by an input record, when its emission is deferred.
+  struct PendingOutput
+  {
+    // The record's type and all its nested types, in dependency order.
+    std::vector<const DDS_TypeCode *> types;
+    std::string topic_name;
+    const DDS_TypeCode * topic_type{nullptr};
+  };
+
+  void
+  consume_input_worker(const size_t worker_id);
+
+  void
+  consume_input(
+    const std::string & next_topic,
+    const std::string & next_type,
+    const DDS_TypeCode * const next_tc,
+    PendingOutput * const pending = nullptr);
+
   void
   on_type_detected(
     const std::string & topic_name,
     const std::string & type_fqname,
-    const DDS_TypeCode * const tc);
+    const DDS_TypeCode * const tc,
+    PendingOutput * const pending = nullptr);
+
+  // Emit the output generated by an input record. Types (and topics) are
+  // only emitted the first time they are committed, after all of their
+  // nested types. If output is ordered, records are emitted in order of
+  // their sequence number.
+  void
+  commit_output(const uint64_t sequence_number, PendingOutput && pending);
+
+  // Emit every output still waiting for the output of a record before it
+  // (e.g. because that record was never consumed), in order.
+  void
+  flush_output();
+
+  void
+  emit_output(const PendingOutput & pending);
 
   bool
   filter_type_name(const std::string & type_name);
 
+  bool
+  filter_type_name_uncached(const std::string & type_name);
+
+  void
+  start_preload();
+
+  void
+  stop_preload();
+
 private:
   const BaseTypeMonitorOptions options_;
 
@@ -84,10 +148,28 @@ protected:
   std::shared_ptr<InputEmitter> input_;
   std::shared_ptr<OutputEmitter> output_;
   TypeCache type_cache_;
-  std::regex type_filter_;
-  std::regex raw_type_filter_;
+  TypeNameFilter type_filter_;
+  TypeNameFilter raw_type_filter_;
+  // Verdicts of filter_type_name(), by (interned) raw type name.
+  FlatHashMap<NameId, bool> filter_cache_;
+  std::shared_mutex filter_cache_mutex_;
   std::mutex active_mutex_;
+  // Number of threads running consume_input(), which stop() waits for.
+  size_t consumers_active_{0};
+  std::mutex consumers_mutex_;
+  std::condition_variable consumers_done_;
   std::atomic_bool active_{true};
+  // Only used when input is processed by multiple workers.
+  std::mutex input_sequence_mutex_;
+  uint64_t input_sequence_{0};
+  std::mutex output_mutex_;
+  uint64_t output_sequence_{0};
+  std::map<uint64_t, PendingOutput> output_pending_;
+  // Types detected in the input, by name.
+  std::map<std::string, const DDS_TypeCode *> output_types_;
+  std::set<std::string> output_topics_;
+  std::vector<std::thread> preload_threads_;
+  std::atomic_bool preload_active_{false};
 };
 }  // namespace robotspy
 
@@ -0,0 +1,44 @@
+// (c) 2023 Copyright, Real-Time Innovations, Inc.  All rights reserved.
+//
+// RTI grants Licensee a license to use, modify, compile, and create derivative
+// works of the Software.  Licensee has the right to distribute object form
+// only for use with RTI products.  The Software is provided "as is", with no
+// warranty of any type, including any warranty for fitness for any purpose.
+// RTI is under no obligation to maintain or support the Software.  RTI shall
+// not be liable for any incidental or consequential damages arising out of the
+// use or inability to use the software.
+#ifndef ROBOTSPY__CORE_TYPECODES_HPP_
+#define ROBOTSPY__CORE_TYPECODES_HPP_
+
+#include <cstddef>
+#include <string_view>
+
+#include "ndds/ndds_c.h"
+
+namespace robotspy
+{
+// A message type of one of the core ROS interface packages (e.g.
+// "std_msgs::msg::Header"), whose typecode is generated with rtiddsgen
+// from the package's IDL when the library is built.
+struct CoreTypeCode
+{
+  const char * name;
+  DDS_TypeCode * (*get_typecode)();
+};
+
+// Generated table of core types, terminated by an entry with a null name.
+// The table is empty if the library was built without core typecodes
+// (ROBOTSPY_CORE_TYPECODES=OFF).
+extern const CoreTypeCode CORE_TYPECODES[];
+
+// Look up the typecode of a core message type, given its normalized name
+// (see normalize_dds_type_name()). Returns nullptr if the type is unknown.
+const DDS_TypeCode *
+find_core_typecode(const std::string_view & type_fqname);
+
+// Number of types in the core types table.
+size_t
+core_typecodes_count();
+}  // namespace robotspy
+
+#endif  // ROBOTSPY__CORE_TYPECODES_HPP_
@@ -14,16 +14,19 @@
 #include <fstream>
 #include <string>
 #include <mutex>
-#include <regex>
 #include <atomic>
 #include <condition_variable>
 #include <chrono>
 #include <deque>
 #include <thread>
+#include <memory>
+#include <unordered_set>
 
 #include "dds/dds.hpp"
 #include "rti/core/cond/AsyncWaitSet.hpp"
 #include "robotspy/base_input_emitter.hpp"
+#include "robotspy/type_filter.hpp"
+#include "robotspy/typecode_fingerprint.hpp"
 #include "robotspy/log.hpp"
 
 namespace robotspy
@@ -32,6 +35,48 @@ namespace robotspy
 struct DDSInputEmitterOptions : public BaseInputEmitterOptions
 {
   std::vector<dds::domain::DomainParticipant> participants;
+  // Number of threads in the pool of each AsyncWaitSet.
+  uint32_t waitset_threads{1};
+  // Dispatch each participant's builtin readers from a dedicated AsyncWaitSet,
+  // instead of sharing a single one among all participants.
+  bool waitset_per_participant{false};
+  bool discovery_dedup{true};
+  // Maximum number of endpoints remembered to suppress duplicate
+  // announcements. When it's reached, all endpoints are forgotten, and their
+  // next announcement is queued again (and found in the type cache).
+  size_t discovery_dedup_capacity{65536};
+  // If not empty, endpoints whose type name doesn't match this regular
+  // expression are dropped as soon as they are taken from the builtin readers.
+  std::string raw_type_filter;
+};
+
+// Identity of an endpoint announcement, as far as the type monitor is
+// concerned: endpoints which share it carry no new information.
+struct DiscoveredEndpointKey
+{
+  std::string topic_name;
+  std::string type_name;
+  TypeCodeFingerprint type_fp;
+
+  bool
+  operator==(const DiscoveredEndpointKey & other) const
+  {
+    return type_fp == other.type_fp &&
+           topic_name == other.topic_name &&
+           type_name == other.type_name;
+  }
+};
+
+struct DiscoveredEndpointKeyHash
+{
+  size_t
+  operator()(const DiscoveredEndpointKey & key) const
+  {
+    size_t h = std::hash<std::string>()(key.topic_name);
+    h ^= std::hash<std::string>()(key.type_name) + 0x9e3779b9 + (h << 6) + (h >> 2);
+    h ^= TypeCodeFingerprintHash()(key.type_fp) + 0x9e3779b9 + (h << 6) + (h >> 2);
+    return h;
+  }
 };
 
 class DDSInputEmitter : public BaseInputEmitter
@@ -46,6 +91,18 @@ public:
   virtual void close();
 
   virtual bool is_active() const;
+
+  uint64_t
+  duplicates_suppressed() const
+  {
+    return duplicates_suppressed_;
+  }
+
+  uint64_t
+  filtered_at_source() const
+  {
+    return filtered_at_source_;
+  }
 protected:
   virtual void
   reader_thread_complete();
@@ -53,6 +110,30 @@ protected:
   virtual void
   monitor_participant(dds::domain::DomainParticipant participant);
 
+  // Returns true if the endpoint's type is rejected by the raw type filter.
+  bool
+  is_filtered_endpoint(const std::string & type_name);
+
+  // Returns true if an endpoint with the same topic, type name, and type
+  // structure was already queued, in which case the sample can be dropped
+  // before cloning its TypeCode. Otherwise, the endpoint is remembered under
+  // the returned `key` until queue_endpoint() fails to queue it.
+  bool
+  is_duplicate_endpoint(
+    const std::string & topic_name,
+    const std::string & type_name,
+    const DDS_TypeCode * const type_tc,
+    DiscoveredEndpointKey & key);
+
+  // Queue an endpoint which isn't a duplicate, and forget it if it can't be
+  // queued, so that its next announcement isn't suppressed.
+  void
+  queue_endpoint(
+    const std::string & topic_name,
+    const std::string & type_name,
+    const DDS_TypeCode * const type_tc,
+    const DiscoveredEndpointKey & key);
+
   template<typename T>
   void
   on_reader_data(dds::sub::DataReader<T> & reader)
@@ -64,14 +145,26 @@ protected:
       }
       auto data = sample.data();
       auto opt_dyn_type = data->get_type_no_copy();
+      DiscoveredEndpointKey key;
       if (opt_dyn_type.is_set()) {
+        const auto & dyn_type = opt_dyn_type.value();
+        if (is_filtered_endpoint(dyn_type.name()) ||
+          is_duplicate_endpoint(data.topic_name(), dyn_type.name(), &dyn_type.native(), key))
+        {
+          continue;
+        }
         LOG(DEBUG) << "--- topic++ : " << data.topic_name()
-          << " (" << opt_dyn_type.value().name() << ")"  << std::endl;
-        queue_input(data.topic_name(), "", &opt_dyn_type.value().native());
+          << " (" << dyn_type.name() << ")"  << std::endl;
+        queue_endpoint(data.topic_name(), "", &dyn_type.native(), key);
       } else {
+        if (is_filtered_endpoint(data.type_name()) ||
+          is_duplicate_endpoint(data.topic_name(), data.type_name(), nullptr, key))
+        {
+          continue;
+        }
         LOG(DEBUG) << "--- topic   : " << data.topic_name()
           << " (" << data.type_name() << ")" << std::endl;
-        queue_input(data.topic_name(), data.type_name(), nullptr);
+        queue_endpoint(data.topic_name(), data.type_name(), nullptr, key);
       }
     }
   }
@@ -81,9 +174,17 @@ private:
 
 protected:
   std::vector<dds::sub::cond::ReadCondition> reader_conditions_;
+  // Index of the participant which owns each entry of reader_conditions_
+  std::vector<size_t> reader_conditions_participant_;
   std::vector<dds::sub::DataReader<dds::topic::SubscriptionBuiltinTopicData>> readers_sub_;
   std::vector<dds::sub::DataReader<dds::topic::PublicationBuiltinTopicData>> readers_pub_;
-  rti::core::cond::AsyncWaitSet waitset_{nullptr};
+  std::vector<rti::core::cond::AsyncWaitSet> waitsets_;
+  // Endpoints queued so far (bounded by discovery_dedup_capacity).
+  std::unordered_set<DiscoveredEndpointKey, DiscoveredEndpointKeyHash> discovered_;
+  std::mutex discovered_mutex_;
+  std::atomic<uint64_t> duplicates_suppressed_{0};
+  std::unique_ptr<TypeNameFilter> raw_type_filter_;
+  std::atomic<uint64_t> filtered_at_source_{0};
 };
 }  // namespace robotspy
 #endif  // ROBOTSPY__DDS_INPUT_EMITTER_HPP_
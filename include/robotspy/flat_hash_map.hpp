@@ -0,0 +1,228 @@
+// (c) 2023 Copyright, Real-Time Innovations, Inc.  All rights reserved.
+//
+// RTI grants Licensee a license to use, modify, compile, and create derivative
+// works of the Software.  Licensee has the right to distribute object form
+// only for use with RTI products.  The Software is provided "as is", with no
+// warranty of any type, including any warranty for fitness for any purpose.
+// RTI is under no obligation to maintain or support the Software.  RTI shall
+// not be liable for any incidental or consequential damages arising out of the
+// use or inability to use the software.
+#ifndef ROBOTSPY__FLAT_HASH_MAP_HPP_
+#define ROBOTSPY__FLAT_HASH_MAP_HPP_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace robotspy
+{
+// Hash for string keys which also accepts std::string_view and C strings,
+// so that lookups don't need to build a std::string.
+struct StringHash
+{
+  using is_transparent = void;
+
+  size_t
+  operator()(const std::string_view & str) const
+  {
+    return std::hash<std::string_view>()(str);
+  }
+};
+
+// Open-addressing hash map with linear probing. The (mixed) hash of every
+// entry is stored next to it, so probes only compare keys when the hashes
+// match, and growing the table doesn't rehash the keys.
+//
+// Lookups accept any key type supported by Hash and KeyEqual (e.g.
+// std::string_view for std::string keys), and callers may precompute the
+// hash of a key with hash() to reuse it across multiple tables or calls.
+//
+// Entries can't be removed individually, and pointers returned by find()
+// and emplace() are invalidated when the table grows.
+template<
+  typename Key,
+  typename Value,
+  typename Hash = std::hash<Key>,
+  typename KeyEqual = std::equal_to<>>
+class FlatHashMap
+{
+public:
+  explicit FlatHashMap(const size_t capacity = 16)
+  {
+    resize(capacity);
+  }
+
+  size_t
+  size() const
+  {
+    return size_;
+  }
+
+  bool
+  empty() const
+  {
+    return size_ == 0;
+  }
+
+  template<typename K>
+  size_t
+  hash(const K & key) const
+  {
+    // Spread the bits of weak hashes (e.g. std::hash of integers), and
+    // reserve 0 to mark empty slots.
+    uint64_t h = static_cast<uint64_t>(Hash()(key));
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return static_cast<size_t>(h | 1);
+  }
+
+  template<typename K>
+  Value *
+  find(const K & key, const size_t key_hash)
+  {
+    const size_t slot = probe(key, key_hash);
+    return (hashes_[slot] != EMPTY) ? &entries_[slot].second : nullptr;
+  }
+
+  template<typename K>
+  const Value *
+  find(const K & key, const size_t key_hash) const
+  {
+    const size_t slot = probe(key, key_hash);
+    return (hashes_[slot] != EMPTY) ? &entries_[slot].second : nullptr;
+  }
+
+  template<typename K>
+  Value *
+  find(const K & key)
+  {
+    return find(key, hash(key));
+  }
+
+  template<typename K>
+  const Value *
+  find(const K & key) const
+  {
+    return find(key, hash(key));
+  }
+
+  // Insert an entry unless the key is already present. Returns the value
+  // associated with the key, and whether it was inserted.
+  template<typename K, typename V>
+  std::pair<Value *, bool>
+  emplace(K && key, V && value, const size_t key_hash)
+  {
+    size_t slot = probe(key, key_hash);
+    if (hashes_[slot] != EMPTY) {
+      return {&entries_[slot].second, false};
+    }
+    if ((size_ + 1) * MAX_LOAD_DEN > hashes_.size() * MAX_LOAD_NUM) {
+      resize(hashes_.size() * 2);
+      slot = probe(key, key_hash);
+    }
+    hashes_[slot] = key_hash;
+    entries_[slot].first = Key(std::forward<K>(key));
+    entries_[slot].second = Value(std::forward<V>(value));
+    size_ += 1;
+    return {&entries_[slot].second, true};
+  }
+
+  template<typename K, typename V>
+  std::pair<Value *, bool>
+  emplace(K && key, V && value)
+  {
+    const size_t key_hash = hash(key);
+    return emplace(std::forward<K>(key), std::forward<V>(value), key_hash);
+  }
+
+  void
+  reserve(const size_t count)
+  {
+    size_t capacity = hashes_.size();
+    while (count * MAX_LOAD_DEN > capacity * MAX_LOAD_NUM) {
+      capacity *= 2;
+    }
+    if (capacity > hashes_.size()) {
+      resize(capacity);
+    }
+  }
+
+  void
+  clear()
+  {
+    std::fill(hashes_.begin(), hashes_.end(), EMPTY);
+    std::fill(entries_.begin(), entries_.end(), std::pair<Key, Value>());
+    size_ = 0;
+  }
+
+  template<typename Fn>
+  void
+  for_each(Fn && fn) const
+  {
+    for (size_t i = 0; i < hashes_.size(); i++) {
+      if (hashes_[i] != EMPTY) {
+        fn(entries_[i].first, entries_[i].second);
+      }
+    }
+  }
+
+private:
+  static constexpr size_t EMPTY = 0;
+  // Grow when the table is 7/8 full.
+  static constexpr size_t MAX_LOAD_NUM = 7;
+  static constexpr size_t MAX_LOAD_DEN = 8;
+
+  // Return the slot containing the key, or the empty slot where it would
+  // be inserted.
+  template<typename K>
+  size_t
+  probe(const K & key, const size_t key_hash) const
+  {
+    const size_t mask = hashes_.size() - 1;
+    size_t slot = key_hash & mask;
+    while (hashes_[slot] != EMPTY &&
+      (hashes_[slot] != key_hash || !KeyEqual()(entries_[slot].first, key)))
+    {
+      slot = (slot + 1) & mask;
+    }
+    return slot;
+  }
+
+  void
+  resize(const size_t capacity)
+  {
+    size_t slots = 2;
+    while (slots < capacity) {
+      slots <<= 1;
+    }
+    std::vector<size_t> hashes(slots, EMPTY);
+    std::vector<std::pair<Key, Value>> entries(slots);
+    const size_t mask = slots - 1;
+    for (size_t i = 0; i < hashes_.size(); i++) {
+      if (hashes_[i] == EMPTY) {
+        continue;
+      }
+      size_t slot = hashes_[i] & mask;
+      while (hashes[slot] != EMPTY) {
+        slot = (slot + 1) & mask;
+      }
+      hashes[slot] = hashes_[i];
+      entries[slot] = std::move(entries_[i]);
+    }
+    hashes_.swap(hashes);
+    entries_.swap(entries);
+  }
+
+  std::vector<size_t> hashes_;
+  std::vector<std::pair<Key, Value>> entries_;
+  size_t size_{0};
+};
+}  // namespace robotspy
+#endif  // ROBOTSPY__FLAT_HASH_MAP_HPP_
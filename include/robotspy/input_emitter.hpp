@@ -20,6 +20,8 @@
 #include <chrono>
 #include <deque>
 #include <thread>
+#include <tuple>
+#include <vector>
 
 #include "dds/dds.hpp"
 
@@ -58,6 +60,24 @@ public:
   virtual
   std::tuple<std::string, std::string, DDS_TypeCode *>
   next() = 0;
+
+  // Replace the contents of `batch` with up to `max` records, waiting (like
+  // next()) only for the first one. The caller owns the buffer, and can reuse
+  // it across calls to avoid reallocating it.
+  // Throws NoInputException if no record could be dequeued.
+  virtual
+  size_t
+  next_batch(
+    std::vector<std::tuple<std::string, std::string, DDS_TypeCode *>> & batch,
+    const size_t max,
+    const std::chrono::milliseconds & timeout,
+    const bool block = false) = 0;
+
+  virtual
+  size_t
+  next_batch(
+    std::vector<std::tuple<std::string, std::string, DDS_TypeCode *>> & batch,
+    const size_t max) = 0;
 };
 }  // namespace robotspy
 #endif  // ROBOTSPY__INPUT_EMITTER_HPP_
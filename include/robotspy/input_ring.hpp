@@ -0,0 +1,145 @@
+// (c) 2023 Copyright, Real-Time Innovations, Inc.  All rights reserved.
+//
+// RTI grants Licensee a license to use, modify, compile, and create derivative
+// works of the Software.  Licensee has the right to distribute object form
+// only for use with RTI products.  The Software is provided "as is", with no
+// warranty of any type, including any warranty for fitness for any purpose.
+// RTI is under no obligation to maintain or support the Software.  RTI shall
+// not be liable for any incidental or consequential damages arising out of the
+// use or inability to use the software.
+#ifndef ROBOTSPY__INPUT_RING_HPP_
+#define ROBOTSPY__INPUT_RING_HPP_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+
+namespace robotspy
+{
+// Bounded lock-free ring buffer based on per-slot sequence numbers
+// (D. Vyukov's bounded queue). Any number of threads may push concurrently;
+// records are popped by the consumer thread(s) with a single CAS each, so the
+// single-consumer case never contends.
+//
+// The ring never blocks: callers are expected to park themselves (e.g. on a
+// condition variable) when try_push()/try_pop() fail, and to use empty() to
+// re-check the ring after announcing that they are about to sleep.
+template<typename T>
+class InputRing
+{
+public:
+  explicit InputRing(const size_t capacity)
+  {
+    if (capacity < 2) {
+      throw std::runtime_error("invalid input ring capacity");
+    }
+    size_t slots = 2;
+    while (slots < capacity) {
+      slots <<= 1;
+    }
+    mask_ = slots - 1;
+    slots_ = std::make_unique<Slot[]>(slots);
+    for (size_t i = 0; i < slots; i++) {
+      slots_[i].seq.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  InputRing(const InputRing &) = delete;
+  InputRing & operator=(const InputRing &) = delete;
+
+  size_t
+  capacity() const
+  {
+    return mask_ + 1;
+  }
+
+  // Approximate number of queued records (exact when the ring is quiescent).
+  size_t
+  size() const
+  {
+    const size_t tail = tail_.load(std::memory_order_acquire);
+    const size_t head = head_.load(std::memory_order_acquire);
+    return (head > tail) ? head - tail : 0;
+  }
+
+  // True if no record is ready to be popped. A record whose slot has been
+  // claimed but not yet published by its producer is not considered ready.
+  bool
+  empty() const
+  {
+    const size_t pos = tail_.load(std::memory_order_acquire);
+    const Slot & slot = slots_[pos & mask_];
+    return slot.seq.load(std::memory_order_acquire) != pos + 1;
+  }
+
+  bool
+  try_push(T && value)
+  {
+    size_t pos = head_.load(std::memory_order_relaxed);
+    Slot * slot = nullptr;
+    while (true) {
+      slot = &slots_[pos & mask_];
+      const size_t seq = slot->seq.load(std::memory_order_acquire);
+      const intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+      if (diff == 0) {
+        if (head_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (diff < 0) {
+        // ring is full
+        return false;
+      } else {
+        pos = head_.load(std::memory_order_relaxed);
+      }
+    }
+    slot->value = std::move(value);
+    slot->seq.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+
+  bool
+  try_pop(T & value)
+  {
+    size_t pos = tail_.load(std::memory_order_relaxed);
+    Slot * slot = nullptr;
+    while (true) {
+      slot = &slots_[pos & mask_];
+      const size_t seq = slot->seq.load(std::memory_order_acquire);
+      const intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+      if (diff == 0) {
+        if (tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (diff < 0) {
+        // ring is empty (or the next record is still being published)
+        return false;
+      } else {
+        pos = tail_.load(std::memory_order_relaxed);
+      }
+    }
+    value = std::move(slot->value);
+    slot->value = T();
+    slot->seq.store(pos + mask_ + 1, std::memory_order_release);
+    return true;
+  }
+
+private:
+  // Keep producer and consumer indices on separate cache lines
+  static const size_t CACHE_LINE_SIZE = 64;
+
+  struct Slot
+  {
+    std::atomic<size_t> seq{0};
+    T value;
+  };
+
+  size_t mask_{0};
+  std::unique_ptr<Slot[]> slots_;
+  alignas(CACHE_LINE_SIZE) std::atomic<size_t> head_{0};
+  alignas(CACHE_LINE_SIZE) std::atomic<size_t> tail_{0};
+};
+}  // namespace robotspy
+#endif  // ROBOTSPY__INPUT_RING_HPP_
@@ -0,0 +1,63 @@
+// (c) 2023 Copyright, Real-Time Innovations, Inc.  All rights reserved.
+//
+// RTI grants Licensee a license to use, modify, compile, and create derivative
+// works of the Software.  Licensee has the right to distribute object form
+// only for use with RTI products.  The Software is provided "as is", with no
+// warranty of any type, including any warranty for fitness for any purpose.
+// RTI is under no obligation to maintain or support the Software.  RTI shall
+// not be liable for any incidental or consequential damages arising out of the
+// use or inability to use the software.
+#ifndef ROBOTSPY__MAPPED_FILE_HPP_
+#define ROBOTSPY__MAPPED_FILE_HPP_
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+namespace robotspy
+{
+// Read-only memory mapping of a regular file.
+class MappedFile
+{
+public:
+  explicit MappedFile(const std::string & path);
+  ~MappedFile();
+
+  MappedFile(const MappedFile &) = delete;
+  MappedFile & operator=(const MappedFile &) = delete;
+
+  static
+  bool
+  is_regular_file(const std::string & path);
+
+  const std::string &
+  path() const
+  {
+    return path_;
+  }
+
+  const char *
+  data() const
+  {
+    return data_;
+  }
+
+  size_t
+  size() const
+  {
+    return size_;
+  }
+
+  std::string_view
+  contents() const
+  {
+    return std::string_view(data_, size_);
+  }
+
+private:
+  std::string path_;
+  const char * data_{nullptr};
+  size_t size_{0};
+};
+}  // namespace robotspy
+#endif  // ROBOTSPY__MAPPED_FILE_HPP_
@@ -0,0 +1,73 @@
+// (c) 2023 Copyright, Real-Time Innovations, Inc.  All rights reserved.
+//
+// RTI grants Licensee a license to use, modify, compile, and create derivative
+// works of the Software.  Licensee has the right to distribute object form
+// only for use with RTI products.  The Software is provided "as is", with no
+// warranty of any type, including any warranty for fitness for any purpose.
+// RTI is under no obligation to maintain or support the Software.  RTI shall
+// not be liable for any incidental or consequential damages arising out of the
+// use or inability to use the software.
+#ifndef ROBOTSPY__NAME_INTERNER_HPP_
+#define ROBOTSPY__NAME_INTERNER_HPP_
+
+#include <cstdint>
+#include <deque>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "robotspy/flat_hash_map.hpp"
+
+namespace robotspy
+{
+typedef uint32_t NameId;
+
+// Symbol table which maps each distinct (type or topic) name to a compact
+// id. Each name is stored once, and ids are never invalidated, so caches
+// can key on ids instead of copies of the names.
+class NameInterner
+{
+public:
+  static constexpr NameId INVALID_ID = UINT32_MAX;
+
+  // The process-wide symbol table.
+  static
+  NameInterner &
+  global();
+
+  NameId
+  intern(const std::string_view & name);
+
+  // Look up a name without interning it. Returns INVALID_ID if the name is
+  // unknown.
+  NameId
+  find(const std::string_view & name) const;
+
+  // The returned reference stays valid for the lifetime of the interner.
+  const std::string &
+  name(const NameId id) const;
+
+  // Id of the result of normalize_dds_type_name() for an interned name.
+  // Normalization is only performed the first time it is requested.
+  NameId
+  normalized(const NameId id);
+
+  NameId
+  normalized(const std::string_view & name)
+  {
+    return normalized(intern(name));
+  }
+
+  size_t
+  size() const;
+
+private:
+  mutable std::shared_mutex mutex_;
+  // Views point to the strings in names_, whose addresses are stable.
+  FlatHashMap<std::string_view, NameId, StringHash> ids_;
+  std::deque<std::string> names_;
+  std::vector<NameId> normalized_;
+};
+}  // namespace robotspy
+#endif  // ROBOTSPY__NAME_INTERNER_HPP_
@@ -0,0 +1,79 @@
+// (c) 2023 Copyright, Real-Time Innovations, Inc.  All rights reserved.
+//
+// RTI grants Licensee a license to use, modify, compile, and create derivative
+// works of the Software.  Licensee has the right to distribute object form
+// only for use with RTI products.  The Software is provided "as is", with no
+// warranty of any type, including any warranty for fitness for any purpose.
+// RTI is under no obligation to maintain or support the Software.  RTI shall
+// not be liable for any incidental or consequential damages arising out of the
+// use or inability to use the software.
+#ifndef ROBOTSPY__TYPE_FILTER_HPP_
+#define ROBOTSPY__TYPE_FILTER_HPP_
+
+#include <memory>
+#include <regex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace robotspy
+{
+// Matches type names against a (ECMAScript) regular expression, with the
+// same semantics as std::regex_match().
+//
+// Most filters are either "match everything", a literal name, or literals
+// joined by ".*" (e.g. "std_msgs::.*", ".*::srv::.*"), possibly as a list
+// of "|" alternatives. These expressions are compiled into a list of literal
+// segments which are matched with plain string searches. Any other
+// expression falls back to std::regex.
+class TypeNameFilter
+{
+public:
+  explicit TypeNameFilter(const std::string & pattern);
+
+  bool
+  match(const std::string_view & name) const;
+
+  const std::string &
+  pattern() const
+  {
+    return pattern_;
+  }
+
+  // True if the filter accepts any name.
+  bool
+  match_all() const
+  {
+    return match_all_;
+  }
+
+  // True if the filter doesn't need std::regex.
+  bool
+  compiled() const
+  {
+    return nullptr == regex_;
+  }
+
+protected:
+  // Literal segments separated by ".*" wildcards.
+  struct Glob
+  {
+    std::vector<std::string> segments;
+  };
+
+  static
+  bool
+  compile_glob(const std::string_view & expr, Glob & glob);
+
+  static
+  bool
+  match_glob(const Glob & glob, const std::string_view & name);
+
+private:
+  std::string pattern_;
+  bool match_all_{false};
+  std::vector<Glob> alternatives_;
+  std::unique_ptr<std::regex> regex_;
+};
+}  // namespace robotspy
+#endif  // ROBOTSPY__TYPE_FILTER_HPP_
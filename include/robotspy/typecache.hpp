@@ -11,12 +11,18 @@
 #define ROBOTSPY__TYPECACHE_HPP_
 
 #include <string>
+#include <array>
+#include <atomic>
+#include <chrono>
 #include <map>
+#include <set>
 #include <vector>
 #include <memory>
 #include <algorithm>
+#include <future>
 #include <mutex>
 #include <ostream>
+#include <unordered_map>
 
 #include "ndds/ndds_c.h"
 
@@ -34,6 +40,11 @@
 
 #include "rcpputils/shared_library.hpp"
 
+#include "robotspy/flat_hash_map.hpp"
+#include "robotspy/name_interner.hpp"
+#include "robotspy/typecode_arena.hpp"
+#include "robotspy/typecode_fingerprint.hpp"
+#include "robotspy/typecode_store.hpp"
 #include "robotspy/typecodes.hpp"
 #include "robotspy/typesupport.hpp"
 
@@ -68,10 +79,24 @@ struct TypeCacheOptions
   bool cyclone_compatible{false};
   bool legacy_rmw_compatible{false};
   RequestReplyMapping request_reply_mapping{RequestReplyMapping::Extended};
+  // Always compare typecodes with DDS_TypeCode_equal(), even ROS types
+  // whose fingerprints match. Other DDS types are always compared.
+  bool paranoid_typecode_checks{false};
+  // File used to persist the cache across runs (see TypeCache::save()).
+  // Types stored in it are loaded on demand, when they are first asserted.
+  std::string cache_file;
+  // How long a failure to find the type support of a ROS type (or of its
+  // package) is remembered, before looking it up again.
+  std::chrono::seconds negative_cache_ttl{60};
+  // Read-only file of prebuilt types (see TypeCache::build_catalog()),
+  // used to look up types which are not cached, without loading their type
+  // support library.
+  std::string catalog_file;
+  // Use the typecodes of core ROS types compiled into the library (see
+  // core_typecodes.hpp), instead of loading their type support library.
+  bool core_typecodes{true};
 };
 
-typedef std::string (*TypeCodeMakeNameFn)(const std::string & base_name);
-
 class TypeCache
 {
 public:
@@ -104,13 +129,49 @@ public:
     const std::string & topic_name,
     const std::string & type_fqname);
 
+  // Write the IDL definitions of all cached types (and of the types they
+  // reference), ordered by their dependencies and grouped by module.
+  void
+  to_idl(std::ostream & out);
+
   std::string
   to_idl();
 
-  const std::vector<DDS_TypeCode *> &
-  cache() const
+  // Return all the aggregate types referenced by a type (including the type
+  // itself), ordered so that every type follows the types it depends on.
+  std::vector<const DDS_TypeCode *>
+  extract_nested_typecodes(const DDS_TypeCode * const tc);
+
+  // Save all cached types (including those which were only stored in the
+  // cache file and never asserted), and the type of every asserted topic.
+  void
+  save(const std::string & path);
+
+  // Assert all the ROS types installed in the ament index, and save them
+  // to a catalog file, which uses the same format as the cache file.
+  // Returns the number of types which could not be loaded.
+  size_t
+  build_catalog(const std::string & path);
+
+  // Compare the typecode of every core ROS type compiled into the library
+  // (see core_typecodes.hpp) with the one converted from its type support.
+  // Returns the names of the types which differ, or couldn't be loaded.
+  static
+  std::vector<std::string>
+  check_core_typecodes(const TypeCacheOptions & options);
+
+  // Number of type support lookups avoided because they recently failed.
+  uint64_t
+  negative_cache_hits() const
+  {
+    return typesupport_failures_avoided_ + typesupport_resolver_.negative_hits();
+  }
+
+  // Memory used to store the typecodes owned by the cache.
+  TypeCodeArenaStats
+  memory_stats() const
   {
-    return tc_cache_;
+    return arena_.stats();
   }
 
 protected:
@@ -122,8 +183,110 @@ protected:
   const DDS_TypeCode *
   find(const std::string & type_fqname, const bool ros_type);
 
-  void
-  insert(const std::string & type_fqname, DDS_TypeCode * const typecode, const bool ros_type);
+  // A cached typecode, its fingerprint, and the interned version of the
+  // definitions it was converted from (see stored_type_version()).
+  struct CachedTypeCode
+  {
+    const DDS_TypeCode * tc{nullptr};
+    TypeCodeFingerprint fp;
+    NameId version{NameInterner::INVALID_ID};
+  };
+
+  CachedTypeCode
+  find_cached(const std::string & type_fqname, const bool ros_type);
+
+  // Like find_cached(), but if the type is not cached, load it from the
+  // cache file or from the catalog. Loaded types (and their nested types) are appended to
+  // `loaded`. If expected_fp is specified, a stored type is only loaded if
+  // it has the same fingerprint.
+  CachedTypeCode
+  find_or_load(
+    const std::string & type_fqname,
+    const bool ros_type,
+    const TypeCodeFingerprint * const expected_fp,
+    std::vector<const DDS_TypeCode *> & loaded);
+
+  // Flags saved in the cache file, to detect files created with
+  // incompatible options.
+  uint32_t
+  cache_file_flags() const;
+
+  // Open a cache file or catalog. Returns nullptr (and logs a warning) if
+  // the file is invalid or was created with different options.
+  std::unique_ptr<TypeCodeStore>
+  open_store(const std::string & path, const char * const description);
+
+  // Installed version of a ROS package's type support libraries (see
+  // TypesupportLibraryResolver::installed_version()), memoized.
+  std::string
+  package_version(const std::string & package_name);
+
+  // Version saved with a type in a cache file or catalog: the installed
+  // version of every ROS package whose types it references, one
+  // "<package>=<version>" line per package.
+  std::string
+  stored_type_version(const DDS_TypeCode * const tc);
+
+  // Interned stored_type_version() of a type, recorded when the type is
+  // cached so that a cache file saved later doesn't pick up packages
+  // upgraded in the meantime.
+  NameId
+  type_version(const DDS_TypeCode * const tc);
+
+  // Check that the packages of a stored type are still installed in the
+  // same version as when the type was stored.
+  bool
+  stored_type_current(const std::string_view & version);
+
+  // Name used to cache a ROS type, given its demangled name.
+  std::string
+  ros_type_cache_name(const std::string & type_fqname);
+
+  // Cache a typecode under the specified name, unless another one was
+  // already cached for the same name (e.g. by a concurrent assertion).
+  // Returns the typecode associated with the name after the call. The
+  // typecode must already be owned by the cache (see insert(DDS_TypeCode*)),
+  // either directly or as a nested member of another cached typecode.
+  CachedTypeCode
+  insert(
+    const std::string & type_fqname,
+    const DDS_TypeCode * const typecode,
+    const bool ros_type,
+    const TypeCodeFingerprint & fp);
+
+  CachedTypeCode
+  insert(
+    const NameId cache_key,
+    const DDS_TypeCode * const typecode,
+    const TypeCodeFingerprint & fp,
+    const NameId version);
+
+  CachedTypeCode
+  insert(
+    const std::string & type_fqname,
+    const DDS_TypeCode * const typecode,
+    const bool ros_type)
+  {
+    return insert(type_fqname, typecode, ros_type, fingerprint_typecode(typecode));
+  }
+
+  // Whether two typecodes with the same fingerprint can be assumed to be
+  // equal without comparing them with DDS_TypeCode_equal(). Only ROS types
+  // are trusted, since they are built by the cache from introspection data
+  // (or were already compared when first asserted), while other types may
+  // use features (e.g. annotations) that fingerprints don't cover.
+  bool
+  trust_fingerprint(const bool ros_type) const;
+
+  // Check if a typecode is equal to a cached one. Fingerprints are compared
+  // first, and DDS_TypeCode_equal() is only used to confirm a match, unless
+  // the fingerprint can be trusted (see trust_fingerprint()).
+  bool
+  equal_to_cached(
+    const CachedTypeCode & cached,
+    const DDS_TypeCode * const tc,
+    const TypeCodeFingerprint & fp,
+    const bool ros_type);
 
   void
   insert(DDS_TypeCode * const typecode);
@@ -137,6 +300,11 @@ protected:
   std::pair<bool, const rosidl_message_type_support_t *>
   load_typesupport(const std::string & type_fqname);
 
+  // Set `own_failure` if an error is caused by looking up the type, or by
+  // loading its package in this thread, rather than in another one.
+  std::pair<bool, const rosidl_message_type_support_t *>
+  load_typesupport_uncached(const std::string & type_fqname, bool & own_failure);
+
   std::tuple<bool, std::vector<const DDS_TypeCode *>, std::vector<const DDS_TypeCode *>>
   assert_typecode(
     const DDS_TypeCode * const tc,
@@ -166,18 +334,10 @@ protected:
   {
     DDS_StructMemberSeq tc_members_stack = DDS_SEQUENCE_INITIALIZER;
     DDS_StructMemberSeq * const tc_members = &tc_members_stack;
+    // Member names are allocated from the arena
     auto scope_exit_tc_members_delete = rcpputils::make_scope_exit(
       [tc_members]()
       {
-        const DDS_Long seq_len =
-        DDS_StructMemberSeq_get_length(tc_members);
-        for (DDS_Long i = 0; i < seq_len; i++) {
-          DDS_StructMember * const tc_member =
-          DDS_StructMemberSeq_get_reference(tc_members, i);
-          DDS_String_free(tc_member->name);
-          tc_member->name = nullptr;
-        }
-
         DDS_StructMemberSeq_finalize(tc_members);
       });
     const DDS_TypeCode * tc_header = nullptr;
@@ -219,10 +379,7 @@ protected:
     if (nullptr != tc_header) {
       DDS_StructMember * const tc_member =
         DDS_StructMemberSeq_get_reference(tc_members, 0);
-      tc_member->name = DDS_String_dup("_header");
-      if (nullptr == tc_member->name) {
-        throw std::runtime_error("failed to duplicate string");
-      }
+      tc_member->name = arena_.strdup("_header");
       tc_member->type = tc_header;
     }
 
@@ -242,14 +399,11 @@ protected:
 
       /* Names in the introspection plugin don't actually end with "_" */
       if (options_.legacy_rmw_compatible) {
-        std::ostringstream ss;
-        ss << member->name_ << "_";
-        tc_member->name = DDS_String_dup(ss.str().c_str());
+        std::string member_name(member->name_, member_name_len);
+        member_name += "_";
+        tc_member->name = arena_.strdup(member_name);
       } else {
-        tc_member->name = DDS_String_dup(member->name_);
-      }
-      if (nullptr == tc_member->name) {
-        throw std::runtime_error("failed to duplicate member name");
+        tc_member->name = arena_.strdup(std::string_view(member->name_, member_name_len));
       }
 
       tc_member->type =
@@ -297,32 +451,20 @@ protected:
         }
       case ::rosidl_typesupport_introspection_cpp::ROS_TYPE_STRING:
         {
-          DDS_ExceptionCode_t ex = DDS_NO_EXCEPTION_CODE;
-          el_tc = DDS_TypeCodeFactory_create_string_tc(
-            tc_factory_,
+          el_tc = shared_typecode(
+            DDS_TK_STRING,
             (member->string_upper_bound_ > 0) ?
             // TODO(asorbini) checked conversion of member->string_upper_bound_
-            static_cast<DDS_UnsignedLong>(member->string_upper_bound_) : LENGTH_UNBOUND,
-            &ex);
-          if (nullptr == el_tc) {
-            throw std::runtime_error("failed to create string typecode");
-          }
-          insert(el_tc);
+            static_cast<DDS_UnsignedLong>(member->string_upper_bound_) : LENGTH_UNBOUND);
           break;
         }
       case ::rosidl_typesupport_introspection_cpp::ROS_TYPE_WSTRING:
         {
-          DDS_ExceptionCode_t ex = DDS_NO_EXCEPTION_CODE;
-          el_tc = DDS_TypeCodeFactory_create_wstring_tc(
-            tc_factory_,
+          el_tc = shared_typecode(
+            DDS_TK_WSTRING,
             (member->string_upper_bound_ > 0) ?
             // TODO(asorbini) checked conversion of member->string_upper_bound_
-            static_cast<DDS_UnsignedLong>(member->string_upper_bound_) : LENGTH_UNBOUND,
-            &ex);
-          if (nullptr == el_tc) {
-            throw std::runtime_error("failed to create wide string typecode");
-          }
-          insert(el_tc);
+            static_cast<DDS_UnsignedLong>(member->string_upper_bound_) : LENGTH_UNBOUND);
           break;
         }
       case ::rosidl_typesupport_introspection_cpp::ROS_TYPE_MESSAGE:
@@ -370,24 +512,12 @@ protected:
     }
 
     if (member->is_array_) {
-      DDS_ExceptionCode_t ex = DDS_NO_EXCEPTION_CODE;
       if (member->array_size_ > 0 && !member->is_upper_bound_) {
         if (member->array_size_ > static_cast<size_t>(INT32_MAX)) {
           throw std::runtime_error("unrepresentable array length");
         }
-        struct DDS_UnsignedLongSeq dimensions = DDS_SEQUENCE_INITIALIZER;
-        if (!DDS_UnsignedLongSeq_ensure_length(&dimensions, 1, 1)) {
-          throw std::runtime_error("failed to ensure sequence length");
-        }
-        *DDS_UnsignedLongSeq_get_reference(&dimensions, 0) =
-          static_cast<DDS_UnsignedLong>(member->array_size_);
-        el_tc = DDS_TypeCodeFactory_create_array_tc(
-          tc_factory_, &dimensions, el_tc, &ex);
-        DDS_UnsignedLongSeq_finalize(&dimensions);
-        if (nullptr == el_tc) {
-          throw std::runtime_error("failed to create array typecode");
-        }
-        insert(el_tc);
+        el_tc = shared_typecode(
+          DDS_TK_ARRAY, static_cast<DDS_UnsignedLong>(member->array_size_), el_tc);
       } else {
         DDS_Long tc_seq_len = LENGTH_UNBOUND;
         if (member->is_upper_bound_) {
@@ -396,20 +526,42 @@ protected:
           }
           tc_seq_len = static_cast<DDS_Long>(member->array_size_);
         }
-        el_tc = DDS_TypeCodeFactory_create_sequence_tc(
-          tc_factory_, tc_seq_len, el_tc, &ex);
-        if (nullptr == el_tc) {
-          throw std::runtime_error("failed to create sequence typecode");
-        }
-        insert(el_tc);
+        el_tc = shared_typecode(
+          DDS_TK_SEQUENCE, static_cast<DDS_UnsignedLong>(tc_seq_len), el_tc);
       }
     }
 
     return el_tc;
   }
 
-  std::vector<DDS_TypeCode *>
-  collect_nested_typecodes(const DDS_TypeCode * const tc, const bool ros_type = true);
+  // Return the (unique) string, sequence, or array typecode with the
+  // specified bound and element type, creating it if needed. For arrays,
+  // the bound is the length of their only dimension.
+  DDS_TypeCode *
+  shared_typecode(
+    const DDS_TCKind kind,
+    const DDS_UnsignedLong bound,
+    const DDS_TypeCode * const element_tc = nullptr);
+
+  // Collect the nested struct types of copy_tc which are not cached yet,
+  // in dependency order. Each distinct type is only visited once.
+  // copy_tc must be a copy of tc (see copy_typecode()), which is walked in
+  // parallel to compute the fingerprint of each nested type.
+  void
+  collect_nested_typecodes(
+    const DDS_TypeCode * const tc,
+    const DDS_TypeCode * const copy_tc,
+    TypeCodeFingerprinter & fingerprinter,
+    const bool ros_type,
+    std::vector<CachedTypeCode> & result);
+
+  // Deep copy a typecode, transforming the names of its struct types (and
+  // of their members) if make_name_fn is specified.
+  DDS_TypeCode *
+  copy_typecode(
+    const DDS_TypeCode * const tc,
+    TypeCodeMakeNameFn make_name_fn,
+    TypeCodeMakeNameFn make_member_name_fn);
 
   DDS_TypeCode *
   resolve_collection_typecode(const DDS_TypeCode * const tc);
@@ -420,10 +572,10 @@ protected:
   DDS_TypeCode *
   demangle_typecode(const DDS_TypeCode * const tc);
 
-  std::vector<const DDS_TypeCode *>
-  extract_nested_typecodes(
-    const DDS_TypeCode * const tc,
-    std::vector<const DDS_TypeCode *> * tc_cache = nullptr);
+  // Return the struct type of a member, or of the elements of a collection
+  // member, or nullptr if the member does not reference a struct type.
+  const DDS_TypeCode *
+  member_struct_typecode(const DDS_TypeCode * const tc, const DDS_UnsignedLong i);
 
   DDS_TypeCode*
   mangle_typecode_recur(
@@ -431,17 +583,96 @@ protected:
     TypeCodeMakeNameFn make_name_fn,
     TypeCodeMakeNameFn make_member_name_fn);
 
+  // Copy a core typecode (see core_typecodes.hpp) in the form produced by
+  // convert_typesupport_members(): aliases (e.g. the typedefs which ROS IDL
+  // uses to declare arrays) are replaced by the types they alias, and
+  // structs only keep the names and types of their members. The typecodes
+  // which are created are appended to `created`, and owned by the caller.
+  // Returns nullptr if the type uses a kind which type support never maps to.
+  const DDS_TypeCode *
+  normalize_core_typecode(
+    const DDS_TypeCode * const tc,
+    std::unordered_map<const DDS_TypeCode *, const DDS_TypeCode *> & normalized,
+    std::vector<DDS_TypeCode *> & created);
+
+
+  static const size_t CACHE_SHARDS = 16;
+
+  // Named types are partitioned by (normalized) name, so that concurrent
+  // assertions of unrelated types don't contend on the same lock. Names
+  // are interned, and each shard is keyed by name id.
+  struct TypeCacheShard
+  {
+    std::mutex mutex;
+    FlatHashMap<NameId, CachedTypeCode> types;
+  };
+
+  TypeCacheShard &
+  shard(const NameId cache_key);
+
+  // Introspection type support library loaded for a package.
+  struct TypesupportLibrary
+  {
+    bool cpp_version{false};
+    std::shared_ptr<rcpputils::SharedLibrary> lib;
+  };
+
+  // Shape of a string or collection typecode. Element types are compared
+  // by identity, since they are either primitive singletons, cached struct
+  // types, or shared typecodes themselves.
+  struct TypeCodeShape
+  {
+    DDS_TCKind kind;
+    DDS_UnsignedLong bound;
+    const DDS_TypeCode * element_tc;
+
+    bool
+    operator==(const TypeCodeShape & other) const
+    {
+      return kind == other.kind && bound == other.bound && element_tc == other.element_tc;
+    }
+  };
+
+  struct TypeCodeShapeHash
+  {
+    size_t
+    operator()(const TypeCodeShape & shape) const
+    {
+      return std::hash<const void *>()(shape.element_tc) ^
+             (static_cast<size_t>(shape.kind) << 32) ^ shape.bound;
+    }
+  };
+
+  NameId
+  cache_key(const std::string & type_fqname, const bool ros_type);
 
 private:
   const TypeCacheOptions options_;
   DDS_TypeCodeFactory * tc_factory_{nullptr};
-  std::vector<DDS_TypeCode *> tc_cache_;
-  std::map<std::string, const DDS_TypeCode *> tc_named_cache_;
-  std::map<std::string, std::shared_ptr<rcpputils::SharedLibrary>> typesupports_cpp_;
-  std::map<std::string, std::shared_ptr<rcpputils::SharedLibrary>> typesupports_c_;
-  std::vector<std::string> lib_path_;
-  std::map<std::string, std::string> topics_cache_;
-  std::mutex cache_mutex_;
+  TypeCodeArena arena_;
+  FlatHashMap<TypeCodeShape, DDS_TypeCode *, TypeCodeShapeHash> shared_tcs_;
+  std::mutex shared_tcs_mutex_;
+  std::array<TypeCacheShard, CACHE_SHARDS> tc_named_cache_;
+  // Libraries are loaded without holding the lock. Threads which need the
+  // libraries of a package while they are being loaded wait on the same
+  // future, then each looks up its own type in them.
+  // The future of a failed load is reset, so that it can be retried.
+  FlatHashMap<std::string, std::shared_future<std::vector<TypesupportLibrary>>,
+    StringHash> typesupports_;
+  std::mutex typesupports_mutex_;
+  TypesupportLibraryResolver typesupport_resolver_;
+  // When the type support of a type last failed to load.
+  FlatHashMap<NameId, std::chrono::steady_clock::time_point> typesupport_failures_;
+  std::mutex typesupport_failures_mutex_;
+  std::atomic<uint64_t> typesupport_failures_avoided_{0};
+  NameInterner & names_;
+  // Normalized type name of each topic
+  FlatHashMap<NameId, NameId> topics_cache_;
+  std::mutex topics_mutex_;
+  std::unique_ptr<TypeCodeStore> store_;
+  std::unique_ptr<TypeCodeStore> catalog_;
+  FlatHashMap<std::string, std::string, StringHash> package_versions_;
+  std::mutex package_versions_mutex_;
 };
 
 }  // namespace robotspy
@@ -0,0 +1,81 @@
+// (c) 2023 Copyright, Real-Time Innovations, Inc.  All rights reserved.
+//
+// RTI grants Licensee a license to use, modify, compile, and create derivative
+// works of the Software.  Licensee has the right to distribute object form
+// only for use with RTI products.  The Software is provided "as is", with no
+// warranty of any type, including any warranty for fitness for any purpose.
+// RTI is under no obligation to maintain or support the Software.  RTI shall
+// not be liable for any incidental or consequential damages arising out of the
+// use or inability to use the software.
+#ifndef ROBOTSPY__TYPECODE_ARENA_HPP_
+#define ROBOTSPY__TYPECODE_ARENA_HPP_
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <vector>
+
+#include "ndds/ndds_c.h"
+
+namespace robotspy
+{
+struct TypeCodeArenaStats
+{
+  // Number of typecodes owned by the arena.
+  size_t typecodes{0};
+  // Bytes used by strings, and reserved for them.
+  size_t string_bytes{0};
+  size_t string_reserved_bytes{0};
+  // Bytes reserved to keep track of owned typecodes.
+  size_t typecode_reserved_bytes{0};
+};
+
+// Storage for the typecodes owned by a TypeCache, and for the strings
+// (e.g. member names) used to build them.
+// Typecodes must still be allocated (and deleted) through the
+// DDS_TypeCodeFactory, but they are tracked in fixed-size blocks that never
+// need to be copied. Strings are bump-allocated from large blocks, and they
+// are all released at once.
+class TypeCodeArena
+{
+public:
+  explicit TypeCodeArena(DDS_TypeCodeFactory * const tc_factory);
+  ~TypeCodeArena();
+
+  TypeCodeArena(const TypeCodeArena &) = delete;
+  TypeCodeArena & operator=(const TypeCodeArena &) = delete;
+
+  // Take ownership of a typecode allocated by the factory.
+  void
+  adopt(DDS_TypeCode * const tc);
+
+  // Copy a string into the arena. The copy is NUL-terminated, and it is
+  // valid until the arena is released.
+  char *
+  strdup(const std::string_view & str);
+
+  // Delete all owned typecodes and release all strings. Returns false if
+  // the factory failed to delete some typecode.
+  bool
+  release();
+
+  TypeCodeArenaStats
+  stats() const;
+
+private:
+  static const size_t TYPECODE_BLOCK_SIZE = 1024;
+  static const size_t STRING_BLOCK_SIZE = 64 * 1024;
+
+  DDS_TypeCodeFactory * tc_factory_{nullptr};
+  mutable std::mutex mutex_;
+  std::vector<std::unique_ptr<DDS_TypeCode *[]>> typecode_blocks_;
+  size_t typecodes_{0};
+  std::vector<std::unique_ptr<char[]>> string_blocks_;
+  char * string_next_{nullptr};
+  size_t string_available_{0};
+  size_t string_bytes_{0};
+  size_t string_reserved_bytes_{0};
+};
+}  // namespace robotspy
+#endif  // ROBOTSPY__TYPECODE_ARENA_HPP_
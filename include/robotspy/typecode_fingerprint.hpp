@@ -0,0 +1,125 @@
+// (c) 2023 Copyright, Real-Time Innovations, Inc.  All rights reserved.
+//
+// RTI grants Licensee a license to use, modify, compile, and create derivative
+// works of the Software.  Licensee has the right to distribute object form
+// only for use with RTI products.  The Software is provided "as is", with no
+// warranty of any type, including any warranty for fitness for any purpose.
+// RTI is under no obligation to maintain or support the Software.  RTI shall
+// not be liable for any incidental or consequential damages arising out of the
+// use or inability to use the software.
+#ifndef ROBOTSPY__TYPECODE_FINGERPRINT_HPP_
+#define ROBOTSPY__TYPECODE_FINGERPRINT_HPP_
+
+#include <cstdint>
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+
+#include "ndds/ndds_c.h"
+
+namespace robotspy
+{
+// 128-bit structural hash of a TypeCode. Fingerprints are computed
+// bottom-up, and cover every property compared by DDS_TypeCode_equal():
+// the fingerprint of an aggregate type covers its name, extensibility,
+// and, for each member, its name, id, flags (key, required/optional,
+// pointer, bitfield bits, visibility), union labels, and the fingerprint of
+// the member's type. Union discriminators and default cases, and the base
+// types and modifiers of value types, are covered as well.
+// References from a type back to one of its enclosing types (recursive
+// types) are hashed as the distance to the enclosing type.
+// Types which are equal according to DDS_TypeCode_equal() have the same
+// fingerprint, but the opposite is only true with very high probability.
+struct TypeCodeFingerprint
+{
+  uint64_t hi{0};
+  uint64_t lo{0};
+
+  bool
+  operator==(const TypeCodeFingerprint & other) const
+  {
+    return hi == other.hi && lo == other.lo;
+  }
+
+  bool
+  operator!=(const TypeCodeFingerprint & other) const
+  {
+    return !(*this == other);
+  }
+};
+
+struct TypeCodeFingerprintHash
+{
+  size_t
+  operator()(const TypeCodeFingerprint & fp) const
+  {
+    return static_cast<size_t>(fp.lo ^ (fp.hi * 0x9e3779b97f4a7c15ULL));
+  }
+};
+
+class FingerprintHasher;
+
+typedef std::string (*TypeCodeMakeNameFn)(const std::string & base_name);
+
+// Computes the fingerprints of one or more types, memoizing the
+// fingerprint of every nested type.
+// The names of struct types and of their members can optionally be
+// transformed before being hashed, to compute the fingerprint that a type
+// would have after being (de)mangled, without actually copying it.
+class TypeCodeFingerprinter
+{
+public:
+  explicit TypeCodeFingerprinter(
+    TypeCodeMakeNameFn make_name_fn = nullptr,
+    TypeCodeMakeNameFn make_member_name_fn = nullptr)
+  : make_name_fn_(make_name_fn),
+    make_member_name_fn_(make_member_name_fn)
+  {}
+
+  TypeCodeFingerprint
+  fingerprint(const DDS_TypeCode * const tc);
+
+private:
+  static const size_t NO_BACK_REF = SIZE_MAX;
+  static const uint32_t BACK_REF_MARKER = 0xffffffff;
+
+  // Fingerprint tc, and return in back_ref_depth the depth of the outermost
+  // type that it (or one of its nested types) refers back to, if any.
+  // The fingerprints of types which refer back to themselves or to one of
+  // their enclosing types are not memoized.
+  TypeCodeFingerprint
+  fingerprint(const DDS_TypeCode * const tc, size_t & back_ref_depth);
+
+  TypeCodeFingerprint
+  nested_fingerprint(const DDS_TypeCode * const tc, size_t & min_back_ref_depth);
+
+  void
+  hash_typecode(
+    const DDS_TypeCode * const tc,
+    const DDS_TCKind tc_kind,
+    FingerprintHasher & hasher,
+    size_t & min_back_ref_depth);
+
+  TypeCodeMakeNameFn make_name_fn_{nullptr};
+  TypeCodeMakeNameFn make_member_name_fn_{nullptr};
+  std::unordered_map<const DDS_TypeCode *, TypeCodeFingerprint> memo_;
+  // Types being fingerprinted, with their nesting depth
+  std::unordered_map<const DDS_TypeCode *, size_t> in_progress_;
+};
+
+TypeCodeFingerprint
+fingerprint_typecode(const DDS_TypeCode * const tc);
+
+}  // namespace robotspy
+
+inline
+std::ostream & operator<<(std::ostream & os, const robotspy::TypeCodeFingerprint & fp)
+{
+  const auto flags = os.flags();
+  os << std::hex << fp.hi << ":" << fp.lo;
+  os.flags(flags);
+  return os;
+}
+
+#endif  // ROBOTSPY__TYPECODE_FINGERPRINT_HPP_
@@ -0,0 +1,29 @@
+// (c) 2023 Copyright, Real-Time Innovations, Inc.  All rights reserved.
+//
+// RTI grants Licensee a license to use, modify, compile, and create derivative
+// works of the Software.  Licensee has the right to distribute object form
+// only for use with RTI products.  The Software is provided "as is", with no
+// warranty of any type, including any warranty for fitness for any purpose.
+// RTI is under no obligation to maintain or support the Software.  RTI shall
+// not be liable for any incidental or consequential damages arising out of the
+// use or inability to use the software.
+#ifndef ROBOTSPY__TYPECODE_IDL_HPP_
+#define ROBOTSPY__TYPECODE_IDL_HPP_
+
+#include <ostream>
+#include <vector>
+
+#include "ndds/ndds_c.h"
+
+namespace robotspy
+{
+// Write the IDL definitions of a set of types, and of all the named types
+// (structs, unions, enums, and aliases) that they reference.
+// Every type is defined once, after the types it depends on, and types are
+// grouped by module, so that each module is only opened once unless the
+// dependencies between modules are circular.
+void
+write_idl(std::ostream & out, const std::vector<const DDS_TypeCode *> & types);
+}  // namespace robotspy
+
+#endif  // ROBOTSPY__TYPECODE_IDL_HPP_
@@ -0,0 +1,142 @@
+// (c) 2023 Copyright, Real-Time Innovations, Inc.  All rights reserved.
+//
+// RTI grants Licensee a license to use, modify, compile, and create derivative
+// works of the Software.  Licensee has the right to distribute object form
+// only for use with RTI products.  The Software is provided "as is", with no
+// warranty of any type, including any warranty for fitness for any purpose.
+// RTI is under no obligation to maintain or support the Software.  RTI shall
+// not be liable for any incidental or consequential damages arising out of the
+// use or inability to use the software.
+#ifndef ROBOTSPY__TYPECODE_STORE_HPP_
+#define ROBOTSPY__TYPECODE_STORE_HPP_
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "ndds/ndds_c.h"
+
+#include "robotspy/flat_hash_map.hpp"
+#include "robotspy/mapped_file.hpp"
+#include "robotspy/typecode_arena.hpp"
+#include "robotspy/typecode_fingerprint.hpp"
+
+namespace robotspy
+{
+// A named type, as stored in (or loaded from) a TypeCodeStore.
+struct TypeCodeStoreEntry
+{
+  std::string name;
+  const DDS_TypeCode * tc{nullptr};
+  TypeCodeFingerprint fp;
+  // Opaque identifier of the version of the definitions the type was
+  // created from (e.g. of the libraries of the ROS packages that define it),
+  // used to detect stale entries.
+  std::string version;
+};
+
+// Compact binary file of named typecodes, and of the type of each topic.
+// Typecodes are stored as a table of records (one for every distinct
+// typecode in the graph of each named type), which only reference records
+// stored before them.
+// Files are memory-mapped, and only their index of names is parsed when
+// opened. Typecodes are materialized on demand.
+class TypeCodeStore
+{
+public:
+  static const uint32_t FORMAT_VERSION = 2;
+
+  // Open a store file. Throws std::runtime_error if the file is invalid.
+  explicit TypeCodeStore(const std::string & path);
+
+  // Write a store file. The file is replaced atomically. Types which can't
+  // be stored (e.g. unions) are skipped, and they are appended to `skipped`
+  // if specified.
+  static
+  void
+  save(
+    const std::string & path,
+    const uint32_t flags,
+    const std::vector<TypeCodeStoreEntry> & types,
+    const std::vector<std::pair<std::string, std::string>> & topics,
+    std::vector<std::string> * const skipped = nullptr);
+
+  const std::string &
+  path() const
+  {
+    return file_.path();
+  }
+
+  // Opaque flags specified when the file was saved.
+  uint32_t
+  flags() const
+  {
+    return flags_;
+  }
+
+  size_t
+  size() const
+  {
+    return types_.size();
+  }
+
+  // Names of all stored types.
+  std::vector<std::string_view>
+  names() const;
+
+  // Fingerprint of a stored type, or nullptr if not stored.
+  const TypeCodeFingerprint *
+  fingerprint(const std::string_view & name) const;
+
+  // Version of a stored type (see TypeCodeStoreEntry), or an empty string
+  // if not stored.
+  std::string_view
+  version(const std::string_view & name) const;
+
+  // Stored type of a topic, or an empty string if not stored.
+  std::string_view
+  topic_type(const std::string_view & topic_name) const;
+
+  // Materialize a stored type, and every stored type that it references
+  // which hasn't been materialized yet. Types are appended to `loaded`
+  // after all of their nested types, and the requested type is always
+  // appended last. Typecodes are owned by the specified arena.
+  // Returns false if the type is not stored.
+  bool
+  load(
+    const std::string_view & name,
+    DDS_TypeCodeFactory * const tc_factory,
+    TypeCodeArena & arena,
+    std::vector<TypeCodeStoreEntry> & loaded);
+
+private:
+  struct StoredType
+  {
+    uint32_t record;
+    TypeCodeFingerprint fp;
+    std::string_view version;
+  };
+
+  DDS_TypeCode *
+  materialize(
+    const uint32_t record,
+    DDS_TypeCodeFactory * const tc_factory,
+    TypeCodeArena & arena,
+    std::vector<TypeCodeStoreEntry> & loaded);
+
+  MappedFile file_;
+  uint32_t flags_{0};
+  std::vector<uint64_t> record_offsets_;
+  FlatHashMap<std::string_view, StoredType, StringHash> types_;
+  FlatHashMap<std::string_view, std::string_view, StringHash> topics_;
+  // Name of the stored type of each record (if any).
+  std::vector<std::string_view> record_names_;
+  std::mutex load_mutex_;
+  std::vector<DDS_TypeCode *> materialized_;
+};
+}  // namespace robotspy
+#endif  // ROBOTSPY__TYPECODE_STORE_HPP_
@@ -10,11 +10,17 @@
 #ifndef ROBOTSPY__TYPESUPPORT_HPP_
 #define ROBOTSPY__TYPESUPPORT_HPP_
 
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
 #include <string>
+#include <string_view>
 #include <tuple>
 #include <memory>
+#include <mutex>
 #include <sstream>
-#include <regex>
+#include <unordered_map>
+#include <vector>
 
 #include "rcpputils/shared_library.hpp"
 #include "rosidl_runtime_c/message_type_support_struct.h"
@@ -35,6 +41,40 @@ private:
   std::string msg_;
 };
 
+// Thrown when the introspection type support of a type can't be found,
+// e.g. because its package is not installed.
+class TypesupportNotFoundException : public std::runtime_error
+{
+public:
+  explicit TypesupportNotFoundException(const std::string & msg)
+  : std::runtime_error(msg) {}
+};
+
+// Components of a ROS 2 type name, e.g. "std_msgs::msg::dds_::String_",
+// "std_msgs::msg::String", or "std_msgs/msg/String". All views point into
+// the scanned name.
+struct RosTypeNameComponents
+{
+  std::string_view package_name;
+  // Everything between the package and the type name, e.g. "msg", "srv",
+  // "action::msg" (the "dds[_]" namespace is not included).
+  std::string_view middle_module;
+  // The type name, without the trailing "_" of mangled names.
+  std::string_view type_name;
+  // True if the type uses the "dds_" namespace (i.e. the mangled names
+  // generated by rmw_connextdds and rmw_fastrtps).
+  bool mangled{false};
+  // True if the type is in the "dds[_]" namespace.
+  bool dds_namespace{false};
+  bool request_reply{false};
+  bool is_request{false};
+};
+
+// Split a type name in its components, without allocating memory. Returns
+// false if the name doesn't have at least a package and a type name.
+bool
+scan_ros_type_name(const std::string_view & type_fqname, RosTypeNameComponents & components);
+
 std::string
 normalize_dds_type_name(const std::string & type_fqname);
 
@@ -47,15 +87,87 @@ parse_ros_type_name(const std::string & type_fqname);
 void
 get_library_path(std::vector<std::string> & library_path);
 
-std::tuple<
-  bool,
-  std::shared_ptr<rcpputils::SharedLibrary>,
-  const rosidl_message_type_support_t *>
-load_instrospection_typesupport_library(
+// Names of all the messages, and of the requests and replies of all the
+// services, of the interface packages registered in the ament index,
+// e.g. "std_msgs::msg::String" or "std_srvs::srv::Empty_Request".
+std::vector<std::string>
+get_installed_ros_types();
+
+// Locates the introspection type support libraries of ROS 2 packages.
+// Packages which register interfaces in the ament index ("rosidl_interfaces"
+// resources) are looked up in their install prefix, other packages in every
+// directory of the library path. Candidate files are checked with stat()
+// before being loaded, and the result of each lookup is cached, so that
+// every package is only searched once. Packages for which no library was
+// found are searched again after negative_ttl.
+class TypesupportLibraryResolver
+{
+public:
+  struct Library
+  {
+    std::string path;
+    bool cpp_version;
+    // Modification time and size of the file when it was found
+    int64_t mtime;
+    uint64_t size;
+  };
+
+  // Use the library path from the environment.
+  explicit TypesupportLibraryResolver(
+    const std::chrono::steady_clock::duration negative_ttl =
+    std::chrono::steady_clock::duration::max());
+
+  explicit TypesupportLibraryResolver(
+    const std::vector<std::string> & library_path,
+    const std::chrono::steady_clock::duration negative_ttl =
+    std::chrono::steady_clock::duration::max());
+
+  // Existing introspection libraries of a package, C libraries first.
+  std::vector<Library>
+  resolve(const std::string & package_name);
+
+  // Identifies the installed version of a package's introspection
+  // libraries, from their path, modification time, and size. Returns an
+  // empty string if no library was found.
+  std::string
+  installed_version(const std::string & package_name);
+
+  // Number of packages found in the ament index.
+  size_t
+  indexed_packages() const
+  {
+    return package_prefixes_.size();
+  }
+
+  // Number of searches avoided because a package was recently not found.
+  uint64_t
+  negative_hits() const
+  {
+    return negative_hits_;
+  }
+
+private:
+  struct Resolved
+  {
+    std::vector<Library> libraries;
+    std::chrono::steady_clock::time_point timestamp;
+  };
+
+  std::vector<std::string> library_path_;
+  const std::chrono::steady_clock::duration negative_ttl_;
+  std::unordered_map<std::string, std::string> package_prefixes_;
+  std::mutex resolved_mutex_;
+  std::unordered_map<std::string, Resolved> resolved_;
+  std::atomic<uint64_t> negative_hits_{0};
+};
+
+// Load every introspection type support library of a package, in order of
+// preference, each with a flag set if it's a C++ library. Throws
+// TypesupportNotFoundException if none could be loaded.
+std::vector<std::pair<bool, std::shared_ptr<rcpputils::SharedLibrary>>>
+open_introspection_typesupport_libraries(
   const std::string & package_name,
-  const std::string & middle_module,
-  const std::string & type_name,
-  const std::vector<std::string> & library_path = std::vector<std::string>());
+  TypesupportLibraryResolver & resolver);
 
 const rosidl_message_type_support_t *
 lookup_introspection_typesupport(
@@ -83,9 +195,14 @@ create_dds_type_name(
   }
 
   std::ostringstream ss;
-  std::string msg_namespace =
-    std::regex_replace(message_namespace, std::regex("__"), "::");
+  std::string_view msg_namespace(message_namespace);
   if (!msg_namespace.empty()) {
+    size_t sep_pos = msg_namespace.find("__");
+    while (sep_pos != std::string_view::npos) {
+      ss << msg_namespace.substr(0, sep_pos) << "::";
+      msg_namespace.remove_prefix(sep_pos + 2);
+      sep_pos = msg_namespace.find("__");
+    }
     ss << msg_namespace << "::";
   }
   ss << "dds" << prefix_sfx << "::" << message_name << message_suffix;
@@ -110,66 +227,8 @@ create_dds_type_name_from_members(
     mangle_prefix);
 }
 
-inline
 std::string
-demangle_dds_type_name(const std::string & dds_type_name)
-{
-  // Check if the name is already in "canonical" ROS 2 form
-  // i.e. <package>::(msg|srv)::<type>
-  size_t ns_count = 0;
-  size_t ns_sep_pos = dds_type_name.find("::");
-  size_t first_sep_pos = std::string::npos;
-  while (ns_sep_pos != std::string::npos) {
-    if (ns_count == 0) {
-      first_sep_pos = ns_sep_pos;
-    }
-    ns_count += 1;
-    ns_sep_pos = dds_type_name.find("::", ns_sep_pos + 2);
-  }
-  if (ns_count == 2
-      && (0 == strncmp(dds_type_name.c_str() + first_sep_pos, "::msg::", 7)
-      || 0 == strncmp(dds_type_name.c_str() + first_sep_pos, "::srv::", 7)))
-  {
-    return std::regex_replace(dds_type_name, std::regex("::"), "/");
-  }
-
-  size_t dds_prefix_len = 8;
-  auto dds_prefix_pos = dds_type_name.rfind("::dds_::");
-  if (dds_prefix_pos == std::string::npos) {
-    dds_prefix_len -= 1;
-    dds_prefix_pos = dds_type_name.rfind("::dds::");
-    if (dds_prefix_pos == std::string::npos) {
-      throw InvalidTopicNameException(
-        std::string("invalid ROS 2 DDS type name 1: ") + dds_type_name);
-    }
-  }
-  // Check that there aren't more "::" after "dds[_]::"
-  if (dds_type_name.rfind("::") != (dds_prefix_pos + dds_prefix_len - 2)) {
-    throw InvalidTopicNameException(
-        std::string("invalid ROS 2 DDS type name 2: ") + dds_type_name);
-  }
-
-  auto type_name = dds_type_name.substr(dds_prefix_pos + dds_prefix_len);
-  if (type_name[type_name.size() - 1] == '_') {
-    type_name = type_name.substr(0, type_name.size() - 1);
-  }
-
-  std::ostringstream ss;
-  size_t search_start = 0;
-  size_t sep_pos;
-  do {
-    sep_pos = dds_type_name.find("::", search_start);
-    if (search_start > 0) {
-      ss << "/";
-    }
-    auto el = dds_type_name.substr(search_start, sep_pos - search_start);
-    ss << el;
-    search_start += el.size() + 2;
-    sep_pos = dds_type_name.find("::", search_start);
-  } while (sep_pos <= dds_prefix_pos);
-  ss << "/" << type_name;
-  return ss.str();
-}
+demangle_dds_type_name(const std::string & dds_type_name);
 }  // namespace robotspy
 
 #endif  // ROBOTSPY__TYPESUPPORT_HPP_
@@ -7,6 +7,10 @@
 // RTI is under no obligation to maintain or support the Software.  RTI shall
 // not be liable for any incidental or consequential damages arising out of the
 // use or inability to use the software.
+#include <cstring>
+#include <exception>
+#include <vector>
+
 #include "rcpputils/scope_exit.hpp"
 #include "robotspy/base_input_emitter.hpp"
 #include "robotspy/log.hpp"
@@ -14,9 +18,11 @@
 namespace robotspy
 {
 BaseInputEmitter::BaseInputEmitter(const BaseInputEmitterOptions & options)
-: options_(options)
+: options_(options),
+  input_queue_(options.queue_capacity)
 {
   LOG(INFO) << options_.input_files.size() << " input files" << std::endl;
+  LOG(DEBUG) << "input queue capacity: " << input_queue_.capacity() << std::endl;
   for (const auto & input_file : options_.input_files) {
     LOG(INFO) << "input file: "
       << ((input_file == "-")? "stdin" : input_file)  << std::endl;
@@ -34,6 +40,7 @@ BaseInputEmitter::open()
   bool read_stdin = false;
   input_streams_.clear();
   input_files_.clear();
+  input_maps_.clear();
   for (const auto & input_file : options_.input_files) {
     const bool is_stdin = (input_file == "-");
     read_stdin = read_stdin || is_stdin;
@@ -41,15 +48,20 @@ BaseInputEmitter::open()
       continue;
     }
     LOG(INFO) << "ooo input file: " << input_file << std::endl;
-    input_files_.emplace_back(std::ifstream(input_file));
-    input_streams_.emplace(input_file, &input_files_.back());
+    if (MappedFile::is_regular_file(input_file)) {
+      input_maps_.emplace_back(std::make_unique<MappedFile>(input_file));
+      continue;
+    }
+    // Pipes and other special files are read like stdin
+    input_files_.emplace_back(std::make_unique<std::ifstream>(input_file));
+    input_streams_.emplace_back(input_file, input_files_.back().get());
   }
   // Always add stdin as the last stream so that it will be consumed last
   if (read_stdin) {
     LOG(INFO) << "ooo input file: stdin" << std::endl;
-    input_streams_.emplace("stdin", &std::cin);
+    input_streams_.emplace_back("stdin", &std::cin);
   }
-  if (input_streams_.size() == 0) {
+  if (input_streams_.size() == 0 && input_maps_.size() == 0) {
     reader_thread_active_ = false;
     return;
   }
@@ -61,15 +73,18 @@ BaseInputEmitter::close()
 {
   active_ = false;
   reader_thread_active_ = false;
-  {
-    std::unique_lock<std::mutex> lock(input_queue_mutex_);
-    input_queue_ready_.notify_all();
-  }
+  wake_input_waiters();
   if (reader_thread_.joinable()) {
     reader_thread_.join();
   }
+  const InputQueueStats stats = queue_stats();
+  LOG(INFO) << "input queue: capacity=" << stats.capacity
+    << ", peak=" << stats.peak_depth
+    << ", dropped=" << stats.dropped
+    << ", coalesced=" << stats.coalesced << std::endl;
   input_streams_.clear();
   input_files_.clear();
+  input_maps_.clear();
 }
 
 bool
@@ -79,12 +94,100 @@ BaseInputEmitter::is_active() const
 }
 
 
-void
+InputQueueStats
+BaseInputEmitter::queue_stats() const
+{
+  InputQueueStats stats;
+  stats.capacity = input_queue_.capacity();
+  stats.depth = input_queue_.size();
+  stats.peak_depth = input_queue_peak_;
+  stats.dropped = input_queue_dropped_;
+  stats.coalesced = input_queue_coalesced_;
+  return stats;
+}
+
+std::string
+BaseInputEmitter::coalesce_key(
+  const std::string & topic_name,
+  const std::string & type_name,
+  const DDS_TypeCode * const type_tc)
+{
+  std::string key;
+  if (type_name.size() > 0 || nullptr == type_tc) {
+    key = type_name;
+  } else {
+    DDS_ExceptionCode_t ex = DDS_NO_EXCEPTION_CODE;
+    key = DDS_TypeCode_name(type_tc, &ex);
+    if (DDS_NO_EXCEPTION_CODE != ex) {
+      throw std::runtime_error("failed to get typecode name");
+    }
+  }
+  key += "@";
+  key += topic_name;
+  return key;
+}
+
+size_t
+BaseInputEmitter::update_pending(const std::string & key, const bool increment)
+{
+  std::lock_guard<std::mutex> lock(input_pending_mutex_);
+  auto pending = input_pending_.find(key);
+  const size_t count = (input_pending_.end() != pending) ? pending->second : 0;
+  if (increment) {
+    input_pending_[key] = count + 1;
+  } else if (count <= 1) {
+    if (input_pending_.end() != pending) {
+      input_pending_.erase(pending);
+    }
+  } else {
+    pending->second = count - 1;
+  }
+  return count;
+}
+
+bool
 BaseInputEmitter::queue_input(
   const std::string & topic_name,
   const std::string & type_name,
   const DDS_TypeCode * const type_tc)
 {
+  return queue_input(std::string(topic_name), std::string(type_name), type_tc);
+}
+
+bool
+BaseInputEmitter::queue_input(
+  std::string && topic_name,
+  std::string && type_name,
+  const DDS_TypeCode * const type_tc)
+{
+  const InputOverflowPolicy policy = options_.overflow_policy;
+  // Records are only counted for coalescing once the queue is half full,
+  // so that an uncongested queue stays free of locks and key allocations.
+  const bool coalesce = InputOverflowPolicy::Coalesce == policy &&
+    input_queue_.size() >= input_queue_.capacity() / 2;
+  std::string pending_key;
+  if (coalesce) {
+    pending_key = coalesce_key(topic_name, type_name, type_tc);
+  }
+  // If the queue is already full, try to get rid of the record before
+  // paying for cloning its TypeCode.
+  if (InputOverflowPolicy::Block != policy &&
+    input_queue_.size() >= input_queue_.capacity())
+  {
+    if (InputOverflowPolicy::Drop == policy) {
+      input_queue_dropped_ += 1;
+      LOG(TRACE) << "dropped input: " << type_name << "@" << topic_name << std::endl;
+      return false;
+    }
+    if (coalesce) {
+      std::lock_guard<std::mutex> lock(input_pending_mutex_);
+      if (input_pending_.find(pending_key) != input_pending_.end()) {
+        input_queue_coalesced_ += 1;
+        LOG(TRACE) << "coalesced input: " << pending_key << std::endl;
+        return false;
+      }
+    }
+  }
   DDS_TypeCode * cloned_tc = nullptr;
   auto tc_factory = DDS_TypeCodeFactory_get_instance();
   if (nullptr == tc_factory) {
@@ -104,74 +207,242 @@ BaseInputEmitter::queue_input(
         DDS_TypeCodeFactory_delete_tc(tc_factory, cloned_tc, &ex);
       }
     });
-  std::unique_lock<std::mutex> lock(input_queue_mutex_);
-  input_queue_.push_back(
-    std::make_tuple(topic_name, type_name, cloned_tc));
-  LOG(TRACE) << "queued input (" << input_queue_.size() << ")" << std::endl;
+  // Count the record as pending before it becomes visible to the consumer,
+  // so that the consumer never decrements a counter which wasn't incremented.
+  size_t already_pending = 0;
+  if (coalesce) {
+    already_pending = update_pending(pending_key, true /* increment */);
+  }
+  auto scope_exit_pending = rcpputils::make_scope_exit(
+    [this, coalesce, &pending_key]() {
+      if (coalesce) {
+        update_pending(pending_key, false /* increment */);
+      }
+    });
+  QueuedInput next{
+    std::make_tuple(std::move(topic_name), std::move(type_name), cloned_tc), pending_key};
+  while (!input_queue_.try_push(std::move(next))) {
+    // The record is only moved into the queue if it was pushed
+    if (InputOverflowPolicy::Drop == policy) {
+      input_queue_dropped_ += 1;
+      LOG(TRACE) << "dropped input: " << std::get<1>(next.record) << "@" <<
+        std::get<0>(next.record) << std::endl;
+      return false;
+    } else if (coalesce && already_pending > 0) {
+      input_queue_coalesced_ += 1;
+      LOG(TRACE) << "coalesced input: " << pending_key << std::endl;
+      return false;
+    }
+    // The queue is full: park until the consumer makes some room.
+    std::unique_lock<std::mutex> lock(input_queue_mutex_);
+    input_producers_waiting_.fetch_add(1);
+    input_queue_space_.wait(lock, [this]() {
+        return !active_ || input_queue_.size() < input_queue_.capacity();
+      });
+    input_producers_waiting_.fetch_sub(1);
+    if (!active_) {
+      return false;
+    }
+  }
+  scope_exit_pending.cancel();
   scope_exit_cloned.cancel();
+  const size_t depth = input_queue_.size();
+  size_t peak = input_queue_peak_.load();
+  while (depth > peak && !input_queue_peak_.compare_exchange_weak(peak, depth)) {
+  }
+  LOG(TRACE) << "queued input (" << depth << ")" << std::endl;
+  // Only wake up the consumer if it went to sleep on an empty queue.
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (input_consumers_waiting_.load() > 0) {
+    std::unique_lock<std::mutex> lock(input_queue_mutex_);
+    input_queue_ready_.notify_one();
+  }
+  return true;
+}
+
+bool
+BaseInputEmitter::pop_input(std::tuple<std::string, std::string, DDS_TypeCode *> & next)
+{
+  QueuedInput queued;
+  if (!input_queue_.try_pop(queued)) {
+    return false;
+  }
+  next = std::move(queued.record);
+  if (!queued.pending_key.empty()) {
+    update_pending(queued.pending_key, false /* increment */);
+  }
+  LOG(TRACE) << "popped input (" << input_queue_.size() << ")" << std::endl;
+  // Only wake up producers if they went to sleep on a full queue.
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (input_producers_waiting_.load() > 0) {
+    std::unique_lock<std::mutex> lock(input_queue_mutex_);
+    input_queue_space_.notify_all();
+  }
+  return true;
+}
+
+void
+BaseInputEmitter::wait_for_input(
+  const std::chrono::steady_clock::time_point & deadline,
+  const bool block)
+{
+  std::unique_lock<std::mutex> lock(input_queue_mutex_);
+  // Announce that we are about to sleep before re-checking the queue, so that
+  // producers which don't see us waiting are guaranteed to be seen by the
+  // predicate.
+  input_consumers_waiting_.fetch_add(1);
+  auto predicate = [this]() {
+      return !is_active() || !reader_thread_active_ || !input_queue_.empty();
+    };
+  if (block) {
+    input_queue_ready_.wait(lock, predicate);
+  } else {
+    input_queue_ready_.wait_until(lock, deadline, predicate);
+  }
+  input_consumers_waiting_.fetch_sub(1);
+}
+
+void
+BaseInputEmitter::wake_input_waiters()
+{
+  std::unique_lock<std::mutex> lock(input_queue_mutex_);
   input_queue_ready_.notify_all();
+  input_queue_space_.notify_all();
 }
 
 void
 BaseInputEmitter::reader_thread(BaseInputEmitter * const self)
 {
-  for (const auto& [input_file, input_stream]: self->input_streams_) {
-    if (!self->is_active()) {
-      break;
-    }
-    LOG(DEBUG) << "consuming input: " << input_file << std::endl;
-    while (self->is_active() && input_stream->peek() != EOF) {
-      std::string line;
-      std::getline(*input_stream, line);
-      if (line.size() == 0) {
-        // ignore empty lines
-        continue;
-      }
-      auto at_pos = line.find("@");
-      std::string next_topic;
-      std::string next_type = line;
-      if (at_pos != std::string::npos) {
-        next_type = line.substr(0, at_pos);
-        next_topic = line.substr(at_pos + 1);
+  try {
+    self->read_mapped_inputs();
+    for (const auto & [input_file, input_stream] : self->input_streams_) {
+      if (!self->is_active()) {
+        break;
       }
-      self->queue_input(next_topic, next_type, nullptr);
+      self->read_input_stream(input_file, *input_stream);
     }
-    LOG(DEBUG) << "consumed input: " << input_file << std::endl;
+  } catch (std::exception & e) {
+    LOG(ERROR) << "failed to read input: " << e.what() << std::endl;
   }
   self->reader_thread_complete();
 }
 
+void
+BaseInputEmitter::read_mapped_inputs()
+{
+  for (const auto & input_map : input_maps_) {
+    if (!is_active()) {
+      break;
+    }
+    LOG(DEBUG) << "consuming input: " << input_map->path()
+      << " (" << input_map->size() << " bytes)" << std::endl;
+    parse_input_lines(input_map->contents());
+    LOG(DEBUG) << "consumed input: " << input_map->path() << std::endl;
+  }
+}
+
+void
+BaseInputEmitter::read_input_stream(
+  const std::string & input_file,
+  std::istream & input_stream)
+{
+  LOG(DEBUG) << "consuming input: " << input_file << std::endl;
+  std::string line;
+  while (is_active() && input_stream.peek() != EOF) {
+    std::getline(input_stream, line);
+    parse_input_line(line);
+  }
+  LOG(DEBUG) << "consumed input: " << input_file << std::endl;
+}
+
+// Split an input line ("TYPE[@TOPIC]") into its topic and type names.
+// Returns false for empty lines, which are ignored.
+static
+bool
+split_input_line(
+  const std::string_view & line,
+  std::string & topic_name,
+  std::string & type_name)
+{
+  if (line.size() == 0) {
+    return false;
+  }
+  const auto at_pos = line.find('@');
+  if (at_pos == std::string_view::npos) {
+    topic_name.clear();
+    type_name = line;
+  } else {
+    topic_name = line.substr(at_pos + 1);
+    type_name = line.substr(0, at_pos);
+  }
+  return true;
+}
+
+void
+BaseInputEmitter::parse_input_lines(const std::string_view & lines)
+{
+  const char * pos = lines.data();
+  const char * const end = lines.data() + lines.size();
+  while (is_active() && pos < end) {
+    const char * nl = static_cast<const char *>(memchr(pos, '\n', end - pos));
+    if (nullptr == nl) {
+      nl = end;
+    }
+    parse_input_line(std::string_view(pos, nl - pos));
+    pos = nl + 1;
+  }
+}
+
+void
+BaseInputEmitter::parse_input_line(const std::string_view & line)
+{
+  std::string topic_name;
+  std::string type_name;
+  if (split_input_line(line, topic_name, type_name)) {
+    queue_input(std::move(topic_name), std::move(type_name), nullptr);
+  }
+}
+
 void
 BaseInputEmitter::reader_thread_complete()
 {
   LOG(DEBUG) << "reader thread complete" << std::endl;
   // active_ = false;
   reader_thread_active_ = false;
-  input_queue_ready_.notify_all();
+  wake_input_waiters();
 }
 
-std::tuple<std::string, std::string, DDS_TypeCode *>
-BaseInputEmitter::next(const std::chrono::milliseconds & timeout, const bool block)
+bool
+BaseInputEmitter::wait_next_input(
+  std::tuple<std::string, std::string, DDS_TypeCode *> & next,
+  const std::chrono::milliseconds & timeout,
+  const bool block)
 {
-  std::unique_lock<std::mutex> lock(input_queue_mutex_);
-  auto now = std::chrono::system_clock::now();
-  if (is_active() && reader_thread_active_ && input_queue_.size() == 0) {
-    auto predicate = [this](){ 
-      return !is_active() || !reader_thread_active_ || input_queue_.size() > 0;
-    };
-    if (block) {
-      input_queue_ready_.wait(lock, predicate);
-    } else if (timeout.count() > 0) {
-      input_queue_ready_.wait_until(lock, now + timeout, predicate);
+  const auto deadline = std::chrono::steady_clock::now() + timeout;
+  while (is_active()) {
+    if (pop_input(next)) {
+      return true;
     }
+    if (!reader_thread_active_) {
+      // Records queued before the reader completed are visible by now.
+      return pop_input(next);
+    }
+    if (!block && std::chrono::steady_clock::now() >= deadline) {
+      break;
+    }
+    wait_for_input(deadline, block);
   }
-  if (is_active() && input_queue_.size() > 0) {
-    auto next = input_queue_.front();
-    input_queue_.pop_front();
-    LOG(TRACE) << "popped input (" << input_queue_.size() << ")" << std::endl;
-    return next;
+  return false;
+}
+
+std::tuple<std::string, std::string, DDS_TypeCode *>
+BaseInputEmitter::next(const std::chrono::milliseconds & timeout, const bool block)
+{
+  std::tuple<std::string, std::string, DDS_TypeCode *> next;
+  if (!wait_next_input(next, timeout, block)) {
+    throw NoInputException();
   }
-  throw NoInputException();
+  return next;
 }
 
 std::tuple<std::string, std::string, DDS_TypeCode *>
@@ -179,4 +450,40 @@ BaseInputEmitter::next()
 {
   return next(std::chrono::milliseconds(0), true);
 }
+
+size_t
+BaseInputEmitter::next_batch(
+  std::vector<std::tuple<std::string, std::string, DDS_TypeCode *>> & batch,
+  const size_t max,
+  const std::chrono::milliseconds & timeout,
+  const bool block)
+{
+  batch.clear();
+  if (max == 0) {
+    return 0;
+  }
+  batch.emplace_back();
+  if (!wait_next_input(batch.back(), timeout, block)) {
+    batch.clear();
+    throw NoInputException();
+  }
+  // Drain whatever else is already available, without waiting for it.
+  while (batch.size() < max) {
+    batch.emplace_back();
+    if (!pop_input(batch.back())) {
+      batch.pop_back();
+      break;
+    }
+  }
+  LOG(TRACE) << "popped input batch (" << batch.size() << ")" << std::endl;
+  return batch.size();
+}
+
+size_t
+BaseInputEmitter::next_batch(
+  std::vector<std::tuple<std::string, std::string, DDS_TypeCode *>> & batch,
+  const size_t max)
+{
+  return next_batch(batch, max, std::chrono::milliseconds(0), true);
+}
 }  // namespace robotspy
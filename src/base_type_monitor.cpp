@@ -10,14 +10,30 @@
 #include <unistd.h>
 #include <string.h>
 
+#include <exception>
+#include <fstream>
 #include <sstream>
 #include <string>
+#include <thread>
 
 #include "robotspy/base_type_monitor.hpp"
 #include "robotspy/log.hpp"
+#include "robotspy/typecode_idl.hpp"
 
 namespace robotspy
 {
+static
+std::string
+typecode_name(const DDS_TypeCode * const tc)
+{
+  DDS_ExceptionCode_t ex = DDS_NO_EXCEPTION_CODE;
+  std::string tc_name = DDS_TypeCode_name(tc, &ex);
+  if (DDS_NO_EXCEPTION_CODE != ex) {
+    throw std::runtime_error("failed to get typecode name");
+  }
+  return tc_name;
+}
+
 BaseTypeMonitor::BaseTypeMonitor(
     std::shared_ptr<InputEmitter> input,
     std::shared_ptr<OutputEmitter> output,
@@ -33,6 +49,14 @@ BaseTypeMonitor::BaseTypeMonitor(
     "type filter: " << options_.type_filter << std::endl;
   LOG(DEBUG) <<
     "raw_type filter: " << options_.raw_type_filter << std::endl;
+  LOG(DEBUG) <<
+    "compiled filters: type=" << type_filter_.compiled() <<
+    ", raw_type=" << raw_type_filter_.compiled() << std::endl;
+  LOG(DEBUG) <<
+    "input batch size: " << options_.input_batch_size << std::endl;
+  LOG(DEBUG) <<
+    "workers: " << options_.workers <<
+    ((options_.ordered_output) ? " (ordered output)" : "") << std::endl;
   LOG(DEBUG) <<
     "cache: { " << options_.cache.cyclone_compatible << ", " <<
     options_.cache.legacy_rmw_compatible << ", " <<
@@ -41,7 +65,7 @@ BaseTypeMonitor::BaseTypeMonitor(
 
 BaseTypeMonitor::~BaseTypeMonitor()
 {
-
+  stop_preload();
 }
 
 void
@@ -51,6 +75,49 @@ BaseTypeMonitor::start()
   std::lock_guard<std::mutex> lock(active_mutex_);
   output_->open();
   input_->open();
+  if (options_.preload) {
+    start_preload();
+  }
+}
+
+void
+BaseTypeMonitor::start_preload()
+{
+  auto types = std::make_shared<std::vector<std::string>>(get_installed_ros_types());
+  auto next_type = std::make_shared<std::atomic<size_t>>(0);
+  const size_t threads = std::max<size_t>(1, std::min(options_.preload_threads, types->size()));
+  LOG(INFO) << "preloading " << types->size() << " ROS types on " << threads <<
+    " threads..." << std::endl;
+  preload_active_ = true;
+  for (size_t i = 0; i < threads; i++) {
+    preload_threads_.emplace_back(
+      [this, types, next_type]() {
+        while (preload_active_) {
+          const size_t next = (*next_type)++;
+          if (next >= types->size()) {
+            break;
+          }
+          try {
+            type_cache_.assert_ros_type((*types)[next]);
+          } catch (std::exception & e) {
+            LOG(DEBUG) << "failed to preload " << (*types)[next] << ": " << e.what() << std::endl;
+          }
+        }
+      });
+  }
+}
+
+void
+BaseTypeMonitor::stop_preload()
+{
+  preload_active_ = false;
+  for (auto & preload_thread : preload_threads_) {
+    preload_thread.join();
+  }
+  if (!preload_threads_.empty()) {
+    LOG(DEBUG) << "preload stopped" << std::endl;
+  }
+  preload_threads_.clear();
 }
 
 void
@@ -58,88 +125,301 @@ BaseTypeMonitor::stop()
 {
   // LOG(INFO) << "stopping monitoring..." << std::endl;
   std::lock_guard<std::mutex> lock(active_mutex_);
-  output_->close();
+  stop_preload();
   input_->close();
+  // Let the consumers finish the records they already dequeued, so that
+  // their output is emitted, and included in the files written below.
+  {
+    std::unique_lock<std::mutex> consumers_lock(consumers_mutex_);
+    consumers_done_.wait(consumers_lock, [this]() {return 0 == consumers_active_;});
+  }
+  output_->close();
+  const TypeCodeArenaStats stats = type_cache_.memory_stats();
+  LOG(INFO) << "typecode storage: typecodes=" << stats.typecodes
+    << ", string_bytes=" << stats.string_bytes
+    << ", reserved_bytes=" << (stats.string_reserved_bytes + stats.typecode_reserved_bytes)
+    << std::endl;
+  LOG(INFO) << "type support lookups avoided by negative cache: " <<
+    type_cache_.negative_cache_hits() << std::endl;
+  if (!options_.idl_file.empty()) {
+    // Only the types which were detected, not every cached type (e.g. those
+    // loaded by --preload, or from the cache file).
+    std::vector<const DDS_TypeCode *> idl_types;
+    {
+      std::lock_guard<std::mutex> output_lock(output_mutex_);
+      for (const auto & output_type : output_types_) {
+        idl_types.push_back(output_type.second);
+      }
+    }
+    std::ofstream idl_out(options_.idl_file);
+    write_idl(idl_out, idl_types);
+    idl_out.close();
+    if (!idl_out) {
+      LOG(ERROR) << "failed to write IDL file: " << options_.idl_file << std::endl;
+    }
+  }
+  if (!options_.cache.cache_file.empty()) {
+    try {
+      type_cache_.save(options_.cache.cache_file);
+    } catch (std::exception & e) {
+      LOG(ERROR) << "failed to save cache file: " << e.what() << std::endl;
+    }
+  }
 }
 
 void
 BaseTypeMonitor::consume_input()
 {
+  LOG(INFO) << "consuming input..." << std::endl;
+  {
+    std::lock_guard<std::mutex> lock(consumers_mutex_);
+    consumers_active_ += 1;
+  }
+  auto scope_exit_consumer = rcpputils::make_scope_exit(
+    [this]() {
+      std::lock_guard<std::mutex> lock(consumers_mutex_);
+      consumers_active_ -= 1;
+      consumers_done_.notify_all();
+    });
+  if (options_.workers <= 1) {
+    consume_input_worker(0);
+    LOG(DEBUG) << "consumed all input" << std::endl;
+    return;
+  }
+  std::mutex worker_error_mutex;
+  std::exception_ptr worker_error;
+  auto worker = [this, &worker_error_mutex, &worker_error](const size_t worker_id) {
+      try {
+        consume_input_worker(worker_id);
+      } catch (std::exception & e) {
+        LOG(ERROR) << "worker " << worker_id << " failed: " << e.what() << std::endl;
+        {
+          std::lock_guard<std::mutex> lock(worker_error_mutex);
+          if (nullptr == worker_error) {
+            worker_error = std::current_exception();
+          }
+        }
+        // Stop the input to release the other workers, like a single worker
+        // would stop consuming it.
+        input_->close();
+      }
+    };
+  std::vector<std::thread> workers;
+  for (size_t i = 1; i < options_.workers; i++) {
+    workers.emplace_back(worker, i);
+  }
+  worker(0);
+  for (auto & worker_thread : workers) {
+    worker_thread.join();
+  }
+  flush_output();
+  if (nullptr != worker_error) {
+    std::rethrow_exception(worker_error);
+  }
+  LOG(DEBUG) << "consumed all input" << std::endl;
+}
+
+void
+BaseTypeMonitor::consume_input_worker(const size_t worker_id)
+{
+  auto tc_factory = DDS_TypeCodeFactory_get_instance();
+  if (nullptr == tc_factory) {
+    throw std::runtime_error("failed to get typecode factory");
+  }
+  const bool deferred_output = options_.workers > 1;
+  // Records are dequeued in batches into a buffer which is reused for the
+  // whole run. Any typecode still owned by the buffer (e.g. because an
+  // unexpected exception interrupted a batch) is released on exit.
+  std::vector<std::tuple<std::string, std::string, DDS_TypeCode *>> batch;
+  batch.reserve(options_.input_batch_size);
+  auto scope_exit_batch = rcpputils::make_scope_exit(
+    [tc_factory, &batch]() {
+      for (auto & next : batch) {
+        DDS_TypeCode * const next_tc = std::get<2>(next);
+        if (nullptr != next_tc) {
+          DDS_ExceptionCode_t ex = DDS_NO_EXCEPTION_CODE;
+          DDS_TypeCodeFactory_delete_tc(tc_factory, next_tc, &ex);
+        }
+      }
+    });
   try {
-    LOG(INFO) << "consuming input..." << std::endl;
     while (input_->is_active()) {
-      std::string next_topic;
-      std::string next_type;
-      DDS_TypeCode * next_tc = nullptr;
-      auto tc_factory = DDS_TypeCodeFactory_get_instance();
-      if (nullptr == tc_factory) {
-        throw std::runtime_error("failed to get typecode factory");
+      LOG(TRACE) << "[" << worker_id << "] waiting for next input..." << std::endl;
+      uint64_t sequence_number = 0;
+      if (options_.ordered_output) {
+        // Dequeue and number records atomically, so that sequence numbers
+        // follow the order of the input queue.
+        std::lock_guard<std::mutex> lock(input_sequence_mutex_);
+        input_->next_batch(batch, options_.input_batch_size);
+        sequence_number = input_sequence_;
+        input_sequence_ += batch.size();
+      } else {
+        input_->next_batch(batch, options_.input_batch_size);
       }
-      auto scope_exit_tc = rcpputils::make_scope_exit(
-        [tc_factory, &next_tc]() {
-          if (nullptr != next_tc) {
-            DDS_ExceptionCode_t ex = DDS_NO_EXCEPTION_CODE;
-            DDS_TypeCodeFactory_delete_tc(tc_factory, next_tc, &ex);
-          }
-        });
-      LOG(TRACE) << "waiting for next input..." << std::endl;
-      std::tie(next_topic, next_type, next_tc) = input_->next();
-      LOG(DEBUG) << ">>> input   : "
-        "topic='" << next_topic << "', type='" << next_type << "', "
-        << "tc=" << next_tc << std::endl;
-      try {
-        if (next_topic.size() > 0) {
-          if (nullptr == next_tc) {
-            if (next_type.size() == 0) {
-              LOG(ERROR) << "xxx no type : " << next_topic << std::endl;
-              continue;
+      for (size_t i = 0; i < batch.size(); i++) {
+        const std::string & next_topic = std::get<0>(batch[i]);
+        const std::string & next_type = std::get<1>(batch[i]);
+        DDS_TypeCode * & next_tc = std::get<2>(batch[i]);
+        if (deferred_output) {
+          PendingOutput pending;
+          try {
+            consume_input(next_topic, next_type, next_tc, &pending);
+          } catch (...) {
+            // Don't hold back the output of the records which other workers
+            // consumed after this one and the rest of this batch.
+            for (; i < batch.size(); i++) {
+              commit_output(sequence_number++, PendingOutput());
             }
-            on_topic_detected(next_topic, next_type);
-          } else {
-            on_topic_detected(next_topic, next_tc);
+            throw;
           }
+          commit_output(sequence_number++, std::move(pending));
         } else {
-          if (nullptr == next_tc) {
-            if (next_type.size() == 0) {
-              LOG(DEBUG) << "xxx empty input received" << std::endl;
-              continue;
-            }
-            on_type_detected(next_type);
-          } else {
-            on_type_detected(next_tc);
-          }
+          consume_input(next_topic, next_type, next_tc);
         }
         if (nullptr != next_tc) {
           DDS_ExceptionCode_t ex = DDS_NO_EXCEPTION_CODE;
           DDS_TypeCodeFactory_delete_tc(tc_factory, next_tc, &ex);
           next_tc = nullptr;
         }
-      } catch (InvalidTopicNameException & e) {
-        LOG(DEBUG) << "xxx invalid : "
-          "topic='" << next_topic << "', type='" << next_type << "', "
-          << "tc=" << next_tc << " (" << e.what() << ")"  << std::endl;
-      } 
+      }
     }
   } catch (NoInputException & e) {
-    LOG(DEBUG) << "received EOF: " << e.what() << std::endl;
+    LOG(DEBUG) << "[" << worker_id << "] received EOF: " << e.what() << std::endl;
+  }
+}
+
+void
+BaseTypeMonitor::commit_output(const uint64_t sequence_number, PendingOutput && pending)
+{
+  std::lock_guard<std::mutex> lock(output_mutex_);
+  if (!options_.ordered_output) {
+    emit_output(pending);
+    return;
+  }
+  output_pending_.emplace(sequence_number, std::move(pending));
+  auto next = output_pending_.begin();
+  while (output_pending_.end() != next && next->first == output_sequence_) {
+    emit_output(next->second);
+    next = output_pending_.erase(next);
+    output_sequence_ += 1;
+  }
+}
+
+void
+BaseTypeMonitor::flush_output()
+{
+  std::lock_guard<std::mutex> lock(output_mutex_);
+  if (!output_pending_.empty()) {
+    LOG(DEBUG) << "flushing " << output_pending_.size() << " pending outputs" << std::endl;
+  }
+  for (const auto & pending : output_pending_) {
+    emit_output(pending.second);
+  }
+  output_pending_.clear();
+}
+
+void
+BaseTypeMonitor::emit_output(const PendingOutput & pending)
+{
+  for (const auto & type_tc : pending.types) {
+    const std::string tc_name = typecode_name(type_tc);
+    if (output_types_.emplace(tc_name, type_tc).second) {
+      LOG(INFO) << "+++ asserted: " << tc_name << std::endl;
+      output_->emit_type(type_tc);
+    } else {
+      LOG(DEBUG) << "--- cached  : " << tc_name << std::endl;
+    }
+  }
+  if (nullptr == pending.topic_type) {
+    return;
+  }
+  const std::string tc_name = typecode_name(pending.topic_type);
+  if (output_topics_.insert(pending.topic_name).second) {
+    LOG(INFO) << "+++ asserted: " << tc_name << "@" << pending.topic_name << std::endl;
+    output_->emit_topic(pending.topic_name, pending.topic_type);
+  } else {
+    LOG(DEBUG) << "--- cached  : " << tc_name << "@" << pending.topic_name << std::endl;
+  }
+}
+
+void
+BaseTypeMonitor::consume_input(
+  const std::string & next_topic,
+  const std::string & next_type,
+  const DDS_TypeCode * const next_tc,
+  PendingOutput * const pending)
+{
+  LOG(DEBUG) << ">>> input   : "
+    "topic='" << next_topic << "', type='" << next_type << "', "
+    << "tc=" << next_tc << std::endl;
+  try {
+    if (next_topic.size() > 0) {
+      if (nullptr == next_tc) {
+        if (next_type.size() == 0) {
+          LOG(ERROR) << "xxx no type : " << next_topic << std::endl;
+          return;
+        }
+        on_type_detected(next_topic, next_type, nullptr, pending);
+      } else {
+        on_type_detected(next_topic, typecode_name(next_tc), next_tc, pending);
+      }
+    } else {
+      if (nullptr == next_tc) {
+        if (next_type.size() == 0) {
+          LOG(DEBUG) << "xxx empty input received" << std::endl;
+          return;
+        }
+        on_type_detected("", next_type, nullptr, pending);
+      } else {
+        on_type_detected("", typecode_name(next_tc), next_tc, pending);
+      }
+    }
+  } catch (InvalidTopicNameException & e) {
+    LOG(DEBUG) << "xxx invalid : "
+      "topic='" << next_topic << "', type='" << next_type << "', "
+      << "tc=" << next_tc << " (" << e.what() << ")"  << std::endl;
+  } catch (TypesupportNotFoundException & e) {
+    LOG(DEBUG) << "xxx unknown : "
+      "topic='" << next_topic << "', type='" << next_type << "' (" << e.what() << ")" <<
+      std::endl;
   }
-  LOG(DEBUG) << "consumed all input" << std::endl;
 }
 
 bool
 BaseTypeMonitor::filter_type_name(const std::string & type_fqname)
+{
+  // The verdict only depends on the name, so each name is only inspected
+  // the first time it is detected.
+  const NameId type_id = NameInterner::global().intern(type_fqname);
+  {
+    std::shared_lock<std::shared_mutex> lock(filter_cache_mutex_);
+    auto cached = filter_cache_.find(type_id);
+    if (nullptr != cached) {
+      LOG(TRACE) << "??? cached verdict: " << type_fqname << " = " << *cached << std::endl;
+      return *cached;
+    }
+  }
+  const bool detected = filter_type_name_uncached(type_fqname);
+  std::unique_lock<std::shared_mutex> lock(filter_cache_mutex_);
+  filter_cache_.emplace(type_id, detected);
+  return detected;
+}
+
+bool
+BaseTypeMonitor::filter_type_name_uncached(const std::string & type_fqname)
 {
   std::string ros_type_name = type_fqname;
   std::string failed = options_.raw_type_filter;
-  bool detected = std::regex_match(type_fqname, raw_type_filter_);
+  bool detected = raw_type_filter_.match(type_fqname);
 
   if (detected) {
     try {
       LOG(DEBUG) << "??? inspect : " << type_fqname << std::endl;
       ros_type_name = demangle_dds_type_name(type_fqname);
-      ros_type_name = normalize_dds_type_name(type_fqname);
+      auto & names = NameInterner::global();
+      ros_type_name = names.name(names.normalized(type_fqname));
       LOG(TRACE) << "??? demangled: " << ros_type_name << std::endl;
-      detected = std::regex_match(ros_type_name, type_filter_);
+      detected = type_filter_.match(ros_type_name);
       if (!detected) {
         failed = options_.type_filter;
       }
@@ -162,7 +442,8 @@ void
 BaseTypeMonitor::on_type_detected(
   const std::string & topic_name,
   const std::string & type_fqname,
-  const DDS_TypeCode * const type_tc)
+  const DDS_TypeCode * const type_tc,
+  PendingOutput * const pending)
 {
   if (type_fqname.size() == 0) {
     throw InvalidTopicNameException("empty type name");
@@ -178,7 +459,8 @@ BaseTypeMonitor::on_type_detected(
     bool ros_type = true;
     std::string demangled_ros_type;
     try {
-      demangled_ros_type = demangle_dds_type_name(normalize_dds_type_name(type_fqname));
+      auto & names = NameInterner::global();
+      demangled_ros_type = demangle_dds_type_name(names.name(names.normalized(type_fqname)));
     } catch (InvalidTopicNameException & e) {
       ros_type = false;
     }
@@ -209,6 +491,24 @@ BaseTypeMonitor::on_type_detected(
     }
   }
   DDS_ExceptionCode_t ex = DDS_NO_EXCEPTION_CODE;
+  if (nullptr != pending || options_.preload) {
+    // Let commit_output() decide what is new, based on what was emitted.
+    // Preloaded types are already cached when they are first detected, so
+    // they are also reported based on what was emitted.
+    PendingOutput output;
+    PendingOutput * const deferred = (nullptr != pending) ? pending : &output;
+    auto type_tc = (new_type) ? new_asserted.back() : already_asserted.back();
+    deferred->types = type_cache_.extract_nested_typecodes(type_tc);
+    if (topic_name.size() > 0) {
+      deferred->topic_name = topic_name;
+      deferred->topic_type = type_tc;
+    }
+    if (nullptr == pending) {
+      std::lock_guard<std::mutex> lock(output_mutex_);
+      emit_output(output);
+    }
+    return;
+  }
   for (const auto & new_t : new_asserted) {
     LOG(INFO) << "+++ asserted: " << DDS_TypeCode_name(new_t, &ex) << std::endl;
     output_->emit_type(new_t);
@@ -216,6 +516,15 @@ BaseTypeMonitor::on_type_detected(
   for (const auto & old_t : already_asserted) {
     LOG(DEBUG) << "--- cached  : " << DDS_TypeCode_name(old_t, &ex) << std::endl;
   }
+  if (!options_.idl_file.empty()) {
+    std::lock_guard<std::mutex> lock(output_mutex_);
+    for (const auto & new_t : new_asserted) {
+      output_types_.emplace(DDS_TypeCode_name(new_t, &ex), new_t);
+    }
+    for (const auto & old_t : already_asserted) {
+      output_types_.emplace(DDS_TypeCode_name(old_t, &ex), old_t);
+    }
+  }
   if (topic_name.size() > 0) {
     auto topic_tc = (new_type) ? new_asserted.back() : already_asserted.back();
     std::string tc_name = DDS_TypeCode_name(topic_tc, &ex);
@@ -0,0 +1,50 @@
+// (c) 2023 Copyright, Real-Time Innovations, Inc.  All rights reserved.
+//
+// RTI grants Licensee a license to use, modify, compile, and create derivative
+// works of the Software.  Licensee has the right to distribute object form
+// only for use with RTI products.  The Software is provided "as is", with no
+// warranty of any type, including any warranty for fitness for any purpose.
+// RTI is under no obligation to maintain or support the Software.  RTI shall
+// not be liable for any incidental or consequential damages arising out of the
+// use or inability to use the software.
+#include "robotspy/core_typecodes.hpp"
+#include "robotspy/flat_hash_map.hpp"
+
+namespace robotspy
+{
+typedef FlatHashMap<std::string_view, const DDS_TypeCode *, StringHash> CoreTypeCodeIndex;
+
+// The generated *_get_typecode() functions initialize their typecode on
+// the first call, which isn't thread-safe, so all of them are called once,
+// when the index is built.
+static
+const CoreTypeCodeIndex &
+core_typecodes_index()
+{
+  static const CoreTypeCodeIndex index = []() {
+      CoreTypeCodeIndex result;
+      for (const CoreTypeCode * entry = CORE_TYPECODES; nullptr != entry->name; entry++) {
+        result.emplace(std::string_view(entry->name), entry->get_typecode());
+      }
+      return result;
+    }();
+  return index;
+}
+
+const DDS_TypeCode *
+find_core_typecode(const std::string_view & type_fqname)
+{
+  const CoreTypeCodeIndex & index = core_typecodes_index();
+  if (index.empty()) {
+    return nullptr;
+  }
+  const DDS_TypeCode * const * const tc = index.find(type_fqname);
+  return (nullptr != tc) ? *tc : nullptr;
+}
+
+size_t
+core_typecodes_count()
+{
+  return core_typecodes_index().size();
+}
+}  // namespace robotspy
@@ -17,6 +17,10 @@ DDSInputEmitter::DDSInputEmitter(const DDSInputEmitterOptions & options)
 : BaseInputEmitter(options),
   options_(options)
 {
+  if (options_.raw_type_filter.size() > 0) {
+    LOG(INFO) << "raw type filter at source: " << options_.raw_type_filter << std::endl;
+    raw_type_filter_ = std::make_unique<TypeNameFilter>(options_.raw_type_filter);
+  }
   for (auto & participant : options_.participants) {
     monitor_participant(participant);
   }
@@ -44,6 +48,8 @@ DDSInputEmitter::monitor_participant(
     throw std::runtime_error("failed to lookup built-in subscriptions DataReader");
   }
   const size_t reader_sub_i = readers_sub_.size() - 1;
+  const size_t participant_i = reader_sub_i;
+  reader_conditions_participant_.push_back(participant_i);
   reader_conditions_.emplace_back(
     dds::sub::cond::ReadCondition(
       readers_sub_.back(),
@@ -61,6 +67,7 @@ DDSInputEmitter::monitor_participant(
     throw std::runtime_error("failed to lookup built-in publication DataReader");
   }
   const size_t reader_pub_i = readers_pub_.size() - 1;
+  reader_conditions_participant_.push_back(participant_i);
   reader_conditions_.emplace_back(
     dds::sub::cond::ReadCondition(
       readers_pub_.back(),
@@ -71,18 +78,92 @@ DDSInputEmitter::monitor_participant(
   ));
 }
 
+bool
+DDSInputEmitter::is_filtered_endpoint(const std::string & type_name)
+{
+  // Samples are still taken from the builtin readers (a QueryCondition would
+  // leave the unmatched ones in the readers' caches), but rejected endpoints
+  // are dropped before their TypeCode is fingerprinted, cloned, or queued.
+  if (nullptr == raw_type_filter_ || raw_type_filter_->match(type_name)) {
+    return false;
+  }
+  filtered_at_source_ += 1;
+  LOG(TRACE) << "xxx source  : " << type_name << std::endl;
+  return true;
+}
+
+bool
+DDSInputEmitter::is_duplicate_endpoint(
+  const std::string & topic_name,
+  const std::string & type_name,
+  const DDS_TypeCode * const type_tc,
+  DiscoveredEndpointKey & key)
+{
+  if (!options_.discovery_dedup) {
+    return false;
+  }
+  key.topic_name = topic_name;
+  key.type_name = type_name;
+  if (nullptr != type_tc) {
+    key.type_fp = fingerprint_typecode(type_tc);
+  }
+  std::lock_guard<std::mutex> lock(discovered_mutex_);
+  if (discovered_.find(key) != discovered_.end()) {
+    duplicates_suppressed_ += 1;
+    LOG(TRACE) << "--- dup     : " << topic_name << " (" << type_name << ")" << std::endl;
+    return true;
+  }
+  if (discovered_.size() >= options_.discovery_dedup_capacity) {
+    LOG(DEBUG) << "forgetting " << discovered_.size() << " discovered endpoints" << std::endl;
+    discovered_.clear();
+  }
+  discovered_.insert(key);
+  return false;
+}
+
+void
+DDSInputEmitter::queue_endpoint(
+  const std::string & topic_name,
+  const std::string & type_name,
+  const DDS_TypeCode * const type_tc,
+  const DiscoveredEndpointKey & key)
+{
+  auto scope_exit_forget = rcpputils::make_scope_exit(
+    [this, &key]() {
+      if (options_.discovery_dedup) {
+        std::lock_guard<std::mutex> lock(discovered_mutex_);
+        discovered_.erase(key);
+      }
+    });
+  if (queue_input(topic_name, type_name, type_tc)) {
+    scope_exit_forget.cancel();
+  }
+}
+
 void
 DDSInputEmitter::open()
 {
-  const rti::core::cond::AsyncWaitSetProperty waitset_props;
-  LOG(DEBUG) << "creating async-waitset..." << std::endl;
-  waitset_ = rti::core::cond::AsyncWaitSet(waitset_props);
-  for (auto & condition : reader_conditions_) {
+  rti::core::cond::AsyncWaitSetProperty waitset_props;
+  waitset_props.thread_pool_size(options_.waitset_threads);
+  size_t waitset_count = 1;
+  if (options_.waitset_per_participant && readers_sub_.size() > 0) {
+    waitset_count = readers_sub_.size();
+  }
+  LOG(DEBUG) << "creating " << waitset_count << " async-waitset(s) with "
+    << options_.waitset_threads << " thread(s) each..." << std::endl;
+  for (size_t i = 0; i < waitset_count; i++) {
+    waitsets_.emplace_back(rti::core::cond::AsyncWaitSet(waitset_props));
+  }
+  for (size_t i = 0; i < reader_conditions_.size(); i++) {
+    auto & condition = reader_conditions_[i];
+    auto & waitset = waitsets_[reader_conditions_participant_[i] % waitset_count];
     LOG(DEBUG) << "attaching reader condition: "
       << condition.data_reader().topic_name() << std::endl;
-    waitset_ += condition;
+    waitset += condition;
+  }
+  for (auto & waitset : waitsets_) {
+    waitset->start();
   }
-  waitset_->start();
   BaseInputEmitter::open();
   reader_thread_active_ = reader_thread_active_ || options_.participants.size() > 0;
 }
@@ -90,14 +171,22 @@ DDSInputEmitter::open()
 void
 DDSInputEmitter::close()
 {
-  if (nullptr != waitset_) {
-    LOG(DEBUG) << "stopping async-waitset.." << std::endl;
-    waitset_->stop();
-    for (auto & condition : reader_conditions_) {
-      waitset_ -= condition;
+  if (waitsets_.size() > 0) {
+    LOG(DEBUG) << "stopping async-waitset(s).." << std::endl;
+    for (auto & waitset : waitsets_) {
+      waitset->stop();
     }
-    waitset_ = nullptr;
-    LOG(DEBUG) << "async-waitset stopped." << std::endl;
+    for (size_t i = 0; i < reader_conditions_.size(); i++) {
+      waitsets_[reader_conditions_participant_[i] % waitsets_.size()] -= reader_conditions_[i];
+    }
+    waitsets_.clear();
+    LOG(DEBUG) << "async-waitset(s) stopped." << std::endl;
+  }
+  if (options_.discovery_dedup) {
+    LOG(INFO) << "duplicate endpoints suppressed: " << duplicates_suppressed_ << std::endl;
+  }
+  if (options_.raw_type_filter.size() > 0) {
+    LOG(INFO) << "endpoints filtered at source: " << filtered_at_source_ << std::endl;
   }
   BaseInputEmitter::close();
 }
@@ -115,6 +204,6 @@ DDSInputEmitter::reader_thread_complete()
   LOG(DEBUG) << "reader thread complete" << std::endl;
   // active_ = false;
   reader_thread_active_ = options_.participants.size() > 0;
-  input_queue_ready_.notify_all();
+  wake_input_waiters();
 }
 }  // namespace robotspy
@@ -0,0 +1,64 @@
+// (c) 2023 Copyright, Real-Time Innovations, Inc.  All rights reserved.
+//
+// RTI grants Licensee a license to use, modify, compile, and create derivative
+// works of the Software.  Licensee has the right to distribute object form
+// only for use with RTI products.  The Software is provided "as is", with no
+// warranty of any type, including any warranty for fitness for any purpose.
+// RTI is under no obligation to maintain or support the Software.  RTI shall
+// not be liable for any incidental or consequential damages arising out of the
+// use or inability to use the software.
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <stdexcept>
+
+#include "rcpputils/scope_exit.hpp"
+#include "robotspy/mapped_file.hpp"
+
+namespace robotspy
+{
+MappedFile::MappedFile(const std::string & path)
+: path_(path)
+{
+  const int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw std::runtime_error("failed to open file: " + path);
+  }
+  auto scope_exit_fd = rcpputils::make_scope_exit(
+    [fd]() {
+      ::close(fd);
+    });
+  struct stat st;
+  if (::fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+    throw std::runtime_error("not a regular file: " + path);
+  }
+  size_ = static_cast<size_t>(st.st_size);
+  if (size_ == 0) {
+    // mmap() doesn't accept empty mappings
+    return;
+  }
+  void * const mapped = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (MAP_FAILED == mapped) {
+    throw std::runtime_error("failed to map file: " + path);
+  }
+  // The file is only scanned front to back
+  ::madvise(mapped, size_, MADV_SEQUENTIAL);
+  data_ = static_cast<const char *>(mapped);
+}
+
+MappedFile::~MappedFile()
+{
+  if (nullptr != data_) {
+    ::munmap(const_cast<char *>(data_), size_);
+  }
+}
+
+bool
+MappedFile::is_regular_file(const std::string & path)
+{
+  struct stat st;
+  return ::stat(path.c_str(), &st) == 0 && S_ISREG(st.st_mode);
+}
+}  // namespace robotspy
@@ -0,0 +1,96 @@
+// (c) 2023 Copyright, Real-Time Innovations, Inc.  All rights reserved.
+//
+// RTI grants Licensee a license to use, modify, compile, and create derivative
+// works of the Software.  Licensee has the right to distribute object form
+// only for use with RTI products.  The Software is provided "as is", with no
+// warranty of any type, including any warranty for fitness for any purpose.
+// RTI is under no obligation to maintain or support the Software.  RTI shall
+// not be liable for any incidental or consequential damages arising out of the
+// use or inability to use the software.
+#include <mutex>
+#include <stdexcept>
+
+#include "robotspy/name_interner.hpp"
+#include "robotspy/typesupport.hpp"
+
+namespace robotspy
+{
+NameInterner &
+NameInterner::global()
+{
+  static NameInterner interner;
+  return interner;
+}
+
+NameId
+NameInterner::intern(const std::string_view & name)
+{
+  // Hash the name only once, outside of the lock.
+  const size_t name_hash = ids_.hash(name);
+  {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    auto interned = ids_.find(name, name_hash);
+    if (nullptr != interned) {
+      return *interned;
+    }
+  }
+  std::unique_lock<std::shared_mutex> lock(mutex_);
+  auto interned = ids_.find(name, name_hash);
+  if (nullptr != interned) {
+    return *interned;
+  }
+  if (names_.size() >= INVALID_ID) {
+    throw std::runtime_error("too many interned names");
+  }
+  const NameId id = static_cast<NameId>(names_.size());
+  names_.emplace_back(name);
+  ids_.emplace(std::string_view(names_.back()), id, name_hash);
+  normalized_.push_back(INVALID_ID);
+  return id;
+}
+
+NameId
+NameInterner::find(const std::string_view & name) const
+{
+  std::shared_lock<std::shared_mutex> lock(mutex_);
+  auto interned = ids_.find(name);
+  return (nullptr != interned) ? *interned : INVALID_ID;
+}
+
+const std::string &
+NameInterner::name(const NameId id) const
+{
+  std::shared_lock<std::shared_mutex> lock(mutex_);
+  if (id >= names_.size()) {
+    throw std::runtime_error("invalid name id");
+  }
+  return names_[id];
+}
+
+NameId
+NameInterner::normalized(const NameId id)
+{
+  {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    if (id >= normalized_.size()) {
+      throw std::runtime_error("invalid name id");
+    }
+    if (INVALID_ID != normalized_[id]) {
+      return normalized_[id];
+    }
+  }
+  // Concurrent callers may normalize the same name, but they will all
+  // store the same result.
+  const NameId normalized_id = intern(normalize_dds_type_name(name(id)));
+  std::unique_lock<std::shared_mutex> lock(mutex_);
+  normalized_[id] = normalized_id;
+  return normalized_id;
+}
+
+size_t
+NameInterner::size() const
+{
+  std::shared_lock<std::shared_mutex> lock(mutex_);
+  return names_.size();
+}
+}  // namespace robotspy
@@ -0,0 +1,134 @@
+// (c) 2023 Copyright, Real-Time Innovations, Inc.  All rights reserved.
+//
+// RTI grants Licensee a license to use, modify, compile, and create derivative
+// works of the Software.  Licensee has the right to distribute object form
+// only for use with RTI products.  The Software is provided "as is", with no
+// warranty of any type, including any warranty for fitness for any purpose.
+// RTI is under no obligation to maintain or support the Software.  RTI shall
+// not be liable for any incidental or consequential damages arising out of the
+// use or inability to use the software.
+#include <cctype>
+#include <cstring>
+
+#include "robotspy/type_filter.hpp"
+
+namespace robotspy
+{
+TypeNameFilter::TypeNameFilter(const std::string & pattern)
+: pattern_(pattern)
+{
+  // regex_match() is always anchored, so explicit anchors are redundant.
+  std::string_view expr(pattern_);
+  if (expr.size() > 0 && expr.front() == '^') {
+    expr.remove_prefix(1);
+  }
+  if (expr.size() > 0 && expr.back() == '$' &&
+    (expr.size() < 2 || expr[expr.size() - 2] != '\\'))
+  {
+    expr.remove_suffix(1);
+  }
+  // Split top-level alternatives. Nested groups are left to std::regex.
+  bool compiled = true;
+  size_t start = 0;
+  for (size_t i = 0; compiled && i <= expr.size(); i++) {
+    if (i < expr.size() && expr[i] == '\\') {
+      i += 1;
+      continue;
+    }
+    if (i < expr.size() && expr[i] != '|') {
+      continue;
+    }
+    Glob glob;
+    compiled = compile_glob(expr.substr(start, i - start), glob);
+    if (compiled) {
+      match_all_ = match_all_ ||
+        (glob.segments.size() == 2 && glob.segments[0].empty() && glob.segments[1].empty());
+      alternatives_.emplace_back(std::move(glob));
+    }
+    start = i + 1;
+  }
+  if (!compiled) {
+    alternatives_.clear();
+    match_all_ = false;
+    regex_ = std::make_unique<std::regex>(pattern_, std::regex::optimize);
+  }
+}
+
+bool
+TypeNameFilter::compile_glob(const std::string_view & expr, Glob & glob)
+{
+  static const char * const SPECIAL_CHARS = "^$\\.*+?()[]{}|";
+  glob.segments.clear();
+  glob.segments.emplace_back();
+  for (size_t i = 0; i < expr.size(); i++) {
+    const char c = expr[i];
+    if (c == '\\') {
+      // Only escaped special characters are literals ("\d", "\w", ... aren't)
+      if (i + 1 >= expr.size() || nullptr == strchr(SPECIAL_CHARS, expr[i + 1])) {
+        return false;
+      }
+      glob.segments.back() += expr[i + 1];
+      i += 1;
+    } else if (c == '.') {
+      if (i + 1 >= expr.size() || expr[i + 1] != '*') {
+        return false;
+      }
+      // Consecutive wildcards are equivalent to a single one
+      if (glob.segments.size() == 1 || glob.segments.back().size() > 0) {
+        glob.segments.emplace_back();
+      }
+      i += 1;
+    } else if (nullptr != strchr(SPECIAL_CHARS, c)) {
+      return false;
+    } else {
+      glob.segments.back() += c;
+    }
+  }
+  return true;
+}
+
+bool
+TypeNameFilter::match_glob(const Glob & glob, const std::string_view & name)
+{
+  const auto & segments = glob.segments;
+  const std::string & first = segments.front();
+  if (segments.size() == 1) {
+    return name == first;
+  }
+  const std::string & last = segments.back();
+  if (name.size() < first.size() + last.size() ||
+    name.compare(0, first.size(), first) != 0 ||
+    name.compare(name.size() - last.size(), last.size(), last) != 0)
+  {
+    return false;
+  }
+  // Find the middle segments in order, leftmost first, between the prefix
+  // and the suffix.
+  std::string_view middle = name.substr(first.size(), name.size() - first.size() - last.size());
+  for (size_t i = 1; i + 1 < segments.size(); i++) {
+    const size_t found = middle.find(segments[i]);
+    if (found == std::string_view::npos) {
+      return false;
+    }
+    middle.remove_prefix(found + segments[i].size());
+  }
+  return true;
+}
+
+bool
+TypeNameFilter::match(const std::string_view & name) const
+{
+  if (match_all_) {
+    return true;
+  }
+  if (nullptr != regex_) {
+    return std::regex_match(name.begin(), name.end(), *regex_);
+  }
+  for (const auto & glob : alternatives_) {
+    if (match_glob(glob, name)) {
+      return true;
+    }
+  }
+  return false;
+}
+}  // namespace robotspy
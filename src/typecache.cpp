@@ -7,7 +7,15 @@
 // RTI is under no obligation to maintain or support the Software.  RTI shall
 // not be liable for any incidental or consequential damages arising out of the
 // use or inability to use the software.
+#include <set>
+#include <sstream>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "robotspy/core_typecodes.hpp"
+#include "robotspy/log.hpp"
 #include "robotspy/typecache.hpp"
+#include "robotspy/typecode_idl.hpp"
 #include "robotspy/typecode_mangle.hpp"
 
 namespace robotspy
@@ -17,17 +25,24 @@ std::string
 make_typecode_name_mangled(const std::string & tc_name) {
   auto norm_tc_name = normalize_dds_type_name(tc_name);
   if (norm_tc_name == tc_name) {
-    std::string package_name;
-    std::string middle_module;
-    std::string type_name;
-    std::tie(package_name, middle_module, type_name) =
-      parse_ros_type_name(demangle_dds_type_name(tc_name));
-    std::stringstream ss;
-    ss << package_name
-      << "::" << middle_module
-      << "::" << "dds_"
-      << "::" << type_name << "_";
-    return ss.str();
+    // Only canonical names (<package>::(msg|srv)::<type>) can be mangled.
+    RosTypeNameComponents components;
+    if (tc_name.find('/') != std::string::npos ||
+      !scan_ros_type_name(tc_name, components) ||
+      (components.middle_module != "msg" && components.middle_module != "srv"))
+    {
+      throw InvalidTopicNameException(
+        std::string("invalid ROS 2 DDS type name 1: ") + tc_name);
+    }
+    std::string mangled_name;
+    mangled_name.reserve(tc_name.size() + 7);
+    mangled_name.append(components.package_name);
+    mangled_name.append("::");
+    mangled_name.append(components.middle_module);
+    mangled_name.append("::dds_::");
+    mangled_name.append(components.type_name);
+    mangled_name.append("_");
+    return mangled_name;
   } else {
     // Assume that the name is already mangled
     // TODO(asorbini) verify that the name is actually mangled
@@ -63,6 +78,22 @@ make_typecode_member_name_mangled(
   }
 }
 
+static
+TypeCodeMakeNameFn
+make_typecode_member_name_mangled_fn(const bool legacy_rmw_compatible)
+{
+  if (legacy_rmw_compatible) {
+    return [](const std::string & member_name) {
+             return make_typecode_member_name_mangled(
+               member_name, true /* legacy_rmw_compatible */);
+           };
+  }
+  return [](const std::string & member_name) {
+           return make_typecode_member_name_mangled(
+             member_name, false /* legacy_rmw_compatible */);
+         };
+}
+
 static
 std::string
 make_typecode_member_name_demangled(
@@ -77,7 +108,10 @@ make_typecode_member_name_demangled(
 
 TypeCache::TypeCache(const TypeCacheOptions & options)
 : options_(options),
-  tc_factory_(DDS_TypeCodeFactory_get_instance())
+  tc_factory_(DDS_TypeCodeFactory_get_instance()),
+  arena_(tc_factory_),
+  typesupport_resolver_(options.negative_cache_ttl),
+  names_(NameInterner::global())
 {
   if (options.cyclone_compatible && options.legacy_rmw_compatible) {
     throw std::runtime_error("multiple compatibility modes enabled");
@@ -95,7 +129,351 @@ TypeCache::TypeCache(const TypeCacheOptions & options)
     throw std::runtime_error("failed to access DDS_TypeCodeFactory");
   }
 
-  get_library_path(lib_path_);
+  if (!options.cache_file.empty() && MappedFile::is_regular_file(options.cache_file)) {
+    store_ = open_store(options.cache_file, "cache file");
+  }
+  if (!options.catalog_file.empty()) {
+    catalog_ = open_store(options.catalog_file, "catalog");
+  }
+}
+
+std::unique_ptr<TypeCodeStore>
+TypeCache::open_store(const std::string & path, const char * const description)
+{
+  std::unique_ptr<TypeCodeStore> store;
+  try {
+    store.reset(new TypeCodeStore(path));
+  } catch (std::exception & e) {
+    LOG(WARNING) << "ignoring " << description << ": " << e.what() << std::endl;
+    return nullptr;
+  }
+  if (store->flags() != cache_file_flags()) {
+    LOG(WARNING) << "ignoring " << description << " created with different options: " <<
+      path << std::endl;
+    return nullptr;
+  }
+  LOG(INFO) << description << ": " << path << " (" << store->size() << " types)" << std::endl;
+  return store;
+}
+
+uint32_t
+TypeCache::cache_file_flags() const
+{
+  uint32_t flags = static_cast<uint32_t>(options_.request_reply_mapping) << 8;
+  flags |= (options_.demangle_ros_names) ? 0x1 : 0;
+  flags |= (options_.cyclone_compatible) ? 0x2 : 0;
+  flags |= (options_.legacy_rmw_compatible) ? 0x4 : 0;
+  return flags;
+}
+
+TypeCache::CachedTypeCode
+TypeCache::find_or_load(
+  const std::string & type_fqname,
+  const bool ros_type,
+  const TypeCodeFingerprint * const expected_fp,
+  std::vector<const DDS_TypeCode *> & loaded)
+{
+  CachedTypeCode cached = find_cached(type_fqname, ros_type);
+  if (nullptr != cached.tc || (nullptr == store_ && nullptr == catalog_)) {
+    return cached;
+  }
+  const std::string & stored_name = names_.name(cache_key(type_fqname, ros_type));
+  // The cache file may contain newer versions of the catalog's types.
+  for (TypeCodeStore * const store : {store_.get(), catalog_.get()}) {
+    if (nullptr == store) {
+      continue;
+    }
+    const TypeCodeFingerprint * const stored_fp = store->fingerprint(stored_name);
+    if (nullptr == stored_fp) {
+      continue;
+    }
+    if (nullptr != expected_fp && *expected_fp != *stored_fp) {
+      LOG(DEBUG) << "stale stored type: " << stored_name << std::endl;
+      continue;
+    }
+    // Without a typecode to compare with, only reuse the stored type if the
+    // packages it was loaded from haven't changed since.
+    if (nullptr == expected_fp && !stored_type_current(store->version(stored_name))) {
+      LOG(WARNING) << "ignoring type stored in " << store->path() <<
+        ", its package changed since it was saved: " << stored_name << std::endl;
+      continue;
+    }
+    std::vector<TypeCodeStoreEntry> stored;
+    store->load(stored_name, tc_factory_, arena_, stored);
+    for (const auto & entry : stored) {
+      // Stored names are already cache keys
+      cached = insert(
+        names_.intern(entry.name), entry.tc, entry.fp, names_.intern(entry.version));
+      if (cached.tc == entry.tc) {
+        loaded.insert(loaded.end(), entry.tc);
+      }
+    }
+    break;
+  }
+  return cached;
+}
+
+std::string
+TypeCache::package_version(const std::string & package_name)
+{
+  {
+    std::lock_guard<std::mutex> lock(package_versions_mutex_);
+    const std::string * const version = package_versions_.find(package_name);
+    if (nullptr != version) {
+      return *version;
+    }
+  }
+  const std::string version = typesupport_resolver_.installed_version(package_name);
+  std::lock_guard<std::mutex> lock(package_versions_mutex_);
+  return *package_versions_.emplace(package_name, version).first;
+}
+
+std::string
+TypeCache::stored_type_version(const DDS_TypeCode * const tc)
+{
+  std::set<std::string> packages;
+  std::unordered_set<const DDS_TypeCode *> visited;
+  std::vector<const DDS_TypeCode *> pending{tc};
+  DDS_ExceptionCode_t ex = DDS_NO_EXCEPTION_CODE;
+  while (!pending.empty()) {
+    const DDS_TypeCode * const next = pending.back();
+    pending.pop_back();
+    if (!visited.insert(next).second) {
+      continue;
+    }
+    const DDS_TCKind tc_kind = DDS_TypeCode_kind(next, &ex);
+    if (DDS_NO_EXCEPTION_CODE != ex) {
+      throw std::runtime_error("failed to get typecode kind");
+    }
+    switch (tc_kind) {
+      case DDS_TK_STRUCT:
+      case DDS_TK_ENUM:
+      case DDS_TK_ALIAS:
+        {
+          const char * const tc_name = DDS_TypeCode_name(next, &ex);
+          if (nullptr == tc_name || DDS_NO_EXCEPTION_CODE != ex) {
+            throw std::runtime_error("failed to get typecode name");
+          }
+          // Only names with a middle module (e.g. "msg") are ROS types
+          RosTypeNameComponents components;
+          if (scan_ros_type_name(tc_name, components) && !components.middle_module.empty()) {
+            packages.emplace(components.package_name);
+          }
+          break;
+        }
+      default:
+        {
+          break;
+        }
+    }
+    if (DDS_TK_STRUCT == tc_kind) {
+      const DDS_UnsignedLong member_count = DDS_TypeCode_member_count(next, &ex);
+      if (DDS_NO_EXCEPTION_CODE != ex) {
+        throw std::runtime_error("failed to get typecode member count");
+      }
+      for (DDS_UnsignedLong i = 0; i < member_count; i++) {
+        const DDS_TypeCode * const member_tc = DDS_TypeCode_member_type(next, i, &ex);
+        if (nullptr == member_tc || DDS_NO_EXCEPTION_CODE != ex) {
+          throw std::runtime_error("failed to get typecode member id");
+        }
+        pending.push_back(member_tc);
+      }
+    } else if (DDS_TK_SEQUENCE == tc_kind || DDS_TK_ARRAY == tc_kind ||
+      DDS_TK_ALIAS == tc_kind)
+    {
+      const DDS_TypeCode * const content_tc = DDS_TypeCode_content_type(next, &ex);
+      if (nullptr == content_tc || DDS_NO_EXCEPTION_CODE != ex) {
+        throw std::runtime_error("failed to get collection typecode");
+      }
+      pending.push_back(content_tc);
+    }
+  }
+  std::string version;
+  for (const auto & package : packages) {
+    version.append(package);
+    version.push_back('=');
+    version.append(package_version(package));
+    version.push_back('\n');
+  }
+  return version;
+}
+
+NameId
+TypeCache::type_version(const DDS_TypeCode * const tc)
+{
+  return names_.intern(stored_type_version(tc));
+}
+
+bool
+TypeCache::stored_type_current(const std::string_view & version)
+{
+  size_t pos = 0;
+  while (pos < version.size()) {
+    const size_t eq_pos = version.find('=', pos);
+    const size_t nl_pos = version.find('\n', pos);
+    if (eq_pos == std::string_view::npos || nl_pos == std::string_view::npos ||
+      eq_pos > nl_pos)
+    {
+      return false;
+    }
+    const std::string package(version.substr(pos, eq_pos - pos));
+    if (version.substr(eq_pos + 1, nl_pos - eq_pos - 1) != package_version(package)) {
+      return false;
+    }
+    pos = nl_pos + 1;
+  }
+  return true;
+}
+
+size_t
+TypeCache::build_catalog(const std::string & path)
+{
+  const std::vector<std::string> types = get_installed_ros_types();
+  LOG(INFO) << "building catalog of " << types.size() << " ROS types..." << std::endl;
+  size_t failed = 0;
+  for (const auto & type_fqname : types) {
+    try {
+      assert_ros_type(type_fqname);
+    } catch (std::exception & e) {
+      LOG(WARNING) << "failed to add type to catalog: " << type_fqname << " (" << e.what() <<
+        ")" << std::endl;
+      failed += 1;
+    }
+  }
+  save(path);
+  return failed;
+}
+
+std::vector<std::string>
+TypeCache::check_core_typecodes(const TypeCacheOptions & options)
+{
+  TypeCacheOptions core_options = options;
+  core_options.cache_file.clear();
+  core_options.catalog_file.clear();
+  core_options.core_typecodes = true;
+  TypeCacheOptions converted_options = core_options;
+  converted_options.core_typecodes = false;
+  TypeCache core_cache(core_options);
+  TypeCache converted_cache(converted_options);
+  std::vector<std::string> mismatched;
+  for (const CoreTypeCode * entry = CORE_TYPECODES; nullptr != entry->name; entry++) {
+    try {
+      bool new_type;
+      std::vector<const DDS_TypeCode *> new_asserted;
+      std::vector<const DDS_TypeCode *> already_asserted;
+      std::tie(new_type, new_asserted, already_asserted) =
+        core_cache.assert_ros_type(entry->name);
+      const DDS_TypeCode * const core_tc =
+        (new_type) ? new_asserted.back() : already_asserted.back();
+      std::tie(new_type, new_asserted, already_asserted) =
+        converted_cache.assert_ros_type(entry->name);
+      const DDS_TypeCode * const converted_tc =
+        (new_type) ? new_asserted.back() : already_asserted.back();
+      DDS_ExceptionCode_t ex = DDS_NO_EXCEPTION_CODE;
+      const DDS_Boolean equal = DDS_TypeCode_equal(core_tc, converted_tc, &ex);
+      if (DDS_NO_EXCEPTION_CODE != ex) {
+        throw std::runtime_error("failed to compare typecodes");
+      }
+      if (!equal) {
+        std::ostringstream core_idl;
+        std::ostringstream converted_idl;
+        write_idl(core_idl, {core_tc});
+        write_idl(converted_idl, {converted_tc});
+        LOG(ERROR) << "core typecode differs from type support: " << entry->name <<
+          std::endl << "--- core typecode:" << std::endl << core_idl.str() <<
+          "--- type support:" << std::endl << converted_idl.str();
+        mismatched.emplace_back(entry->name);
+      }
+    } catch (std::exception & e) {
+      LOG(ERROR) << "failed to check core typecode: " << entry->name << " (" << e.what() <<
+        ")" << std::endl;
+      mismatched.emplace_back(entry->name);
+    }
+  }
+  return mismatched;
+}
+
+std::string
+TypeCache::ros_type_cache_name(const std::string & type_fqname)
+{
+  // type_fqname is assumed to be a "demangled" type name, i.e. in the form
+  // "<package>::<middle>::<type>". Check if we are caching types using
+  // mangled names and if so, tranform it.
+  if (!options_.demangle_ros_names) {
+    return make_typecode_name_mangled(type_fqname);
+  } else {
+    return normalize_dds_type_name(type_fqname);
+  }
+}
+
+void
+TypeCache::save(const std::string & path)
+{
+  // Make sure that stored types which were never asserted aren't lost
+  if (nullptr != store_) {
+    for (const auto & name : store_->names()) {
+      std::vector<const DDS_TypeCode *> loaded;
+      find_or_load(std::string(name), false, nullptr, loaded);
+    }
+  }
+  std::vector<TypeCodeStoreEntry> types;
+  for (auto & cache_shard : tc_named_cache_) {
+    std::lock_guard<std::mutex> lock(cache_shard.mutex);
+    cache_shard.types.for_each(
+      [this, &types](const NameId cache_key, const CachedTypeCode & cached) {
+        TypeCodeStoreEntry entry;
+        entry.name = names_.name(cache_key);
+        entry.tc = cached.tc;
+        entry.fp = cached.fp;
+        entry.version = names_.name(cached.version);
+        types.push_back(std::move(entry));
+      });
+  }
+  std::vector<std::pair<std::string, std::string>> topics;
+  {
+    std::lock_guard<std::mutex> lock(topics_mutex_);
+    topics_cache_.for_each(
+      [this, &topics](const NameId topic_id, const NameId type_id) {
+        topics.emplace_back(names_.name(topic_id), names_.name(type_id));
+      });
+  }
+  std::vector<std::string> skipped;
+  TypeCodeStore::save(path, cache_file_flags(), types, topics, &skipped);
+  for (const auto & name : skipped) {
+    LOG(DEBUG) << "type not saved to cache file: " << name << std::endl;
+  }
+  LOG(INFO) << "saved " << (types.size() - skipped.size()) << " types to cache file: " <<
+    path << std::endl;
+}
+
+void
+TypeCache::to_idl(std::ostream & out)
+{
+  std::vector<std::pair<std::string, const DDS_TypeCode *>> cached;
+  for (auto & cache_shard : tc_named_cache_) {
+    std::lock_guard<std::mutex> lock(cache_shard.mutex);
+    cache_shard.types.for_each(
+      [this, &cached](const NameId cache_key, const CachedTypeCode & entry) {
+        cached.emplace_back(names_.name(cache_key), entry.tc);
+      });
+  }
+  // Sort types by name, so that the output doesn't depend on the order in
+  // which they were asserted.
+  std::sort(cached.begin(), cached.end());
+  std::vector<const DDS_TypeCode *> types;
+  types.reserve(cached.size());
+  for (auto & entry : cached) {
+    types.push_back(entry.second);
+  }
+  write_idl(out, types);
+}
+
+std::string
+TypeCache::to_idl()
+{
+  std::ostringstream ss;
+  to_idl(ss);
+  return ss.str();
 }
 TypeCache::~TypeCache()
 {
@@ -104,57 +482,171 @@ TypeCache::~TypeCache()
 void
 TypeCache::clear(const bool nothrow)
 {
-  for (auto & tc : tc_cache_) {
-    DDS_ExceptionCode_t ex = DDS_NO_EXCEPTION_CODE;
-    DDS_TypeCodeFactory_delete_tc(tc_factory_, tc, &ex);
-    if (!nothrow && DDS_NO_EXCEPTION_CODE != ex) {
-      throw std::runtime_error("failed to delete typecode");
+  for (auto & cache_shard : tc_named_cache_) {
+    std::lock_guard<std::mutex> shard_lock(cache_shard.mutex);
+    if (!nothrow) {
+      cache_shard.types.clear();
+    } else {
+      try {
+        cache_shard.types.clear();
+      } catch (std::exception & e) {
+        // suppress exceptions
+        (void)e;
+      }
     }
   }
-  if (!nothrow) {
-    tc_named_cache_.clear();
-  } else {
-    try {
-      tc_named_cache_.clear();
-    } catch (std::exception & e) {
-      // suppress exceptions
-      (void)e;
-    }
+  {
+    std::lock_guard<std::mutex> shared_lock(shared_tcs_mutex_);
+    shared_tcs_.clear();
+  }
+  // All typecodes (and their member names) are released at once
+  if (!arena_.release() && !nothrow) {
+    throw std::runtime_error("failed to delete typecode");
   }
 }
 
 void
 TypeCache::unload()
 {
-  typesupports_cpp_.clear();
-  typesupports_c_.clear();
+  std::lock_guard<std::mutex> lock(typesupports_mutex_);
+  typesupports_.clear();
+}
+
+TypeCache::TypeCacheShard &
+TypeCache::shard(const NameId cache_key)
+{
+  return tc_named_cache_[cache_key % CACHE_SHARDS];
+}
+
+NameId
+TypeCache::cache_key(const std::string & type_fqname, const bool ros_type)
+{
+  return (ros_type) ? names_.normalized(type_fqname) : names_.intern(type_fqname);
 }
 
 const DDS_TypeCode *
 TypeCache::find(const std::string & type_fqname, const bool ros_type)
 {
-  auto cached = tc_named_cache_.find(
-    (ros_type ? normalize_dds_type_name(type_fqname) : type_fqname));
-  if (tc_named_cache_.end() != cached) {
-    return cached->second;
-  }
-  return nullptr;
+  return find_cached(type_fqname, ros_type).tc;
 }
 
-void
+TypeCache::CachedTypeCode
+TypeCache::find_cached(const std::string & type_fqname, const bool ros_type)
+{
+  const NameId cache_key = this->cache_key(type_fqname, ros_type);
+  TypeCacheShard & cache_shard = shard(cache_key);
+  std::lock_guard<std::mutex> lock(cache_shard.mutex);
+  auto cached = cache_shard.types.find(cache_key);
+  return (nullptr != cached) ? *cached : CachedTypeCode();
+}
+
+TypeCache::CachedTypeCode
+TypeCache::insert(
+  const std::string & type_fqname, const DDS_TypeCode * const typecode,
+  const bool ros_type,
+  const TypeCodeFingerprint & fp)
+{
+  return insert(this->cache_key(type_fqname, ros_type), typecode, fp, type_version(typecode));
+}
+
+TypeCache::CachedTypeCode
 TypeCache::insert(
-  const std::string & type_fqname, DDS_TypeCode * const typecode,
+  const NameId cache_key,
+  const DDS_TypeCode * const typecode,
+  const TypeCodeFingerprint & fp,
+  const NameId version)
+{
+  CachedTypeCode entry;
+  entry.tc = typecode;
+  entry.fp = fp;
+  entry.version = version;
+  TypeCacheShard & cache_shard = shard(cache_key);
+  std::lock_guard<std::mutex> lock(cache_shard.mutex);
+  auto cached = cache_shard.types.emplace(cache_key, entry);
+  return *cached.first;
+}
+
+bool
+TypeCache::trust_fingerprint(const bool ros_type) const
+{
+  return ros_type && !options_.paranoid_typecode_checks;
+}
+
+bool
+TypeCache::equal_to_cached(
+  const CachedTypeCode & cached,
+  const DDS_TypeCode * const tc,
+  const TypeCodeFingerprint & fp,
   const bool ros_type)
 {
-  tc_named_cache_.emplace(
-    (ros_type ? normalize_dds_type_name(type_fqname) : type_fqname), typecode);
-  tc_cache_.insert(tc_cache_.end(), typecode);
+  if (cached.fp != fp) {
+    return false;
+  }
+  if (trust_fingerprint(ros_type)) {
+    return true;
+  }
+  DDS_ExceptionCode_t ex = DDS_NO_EXCEPTION_CODE;
+  return DDS_TypeCode_equal(cached.tc, tc, &ex);
 }
 
 void
 TypeCache::insert(DDS_TypeCode * const typecode)
 {
-  tc_cache_.insert(tc_cache_.end(), typecode);
+  arena_.adopt(typecode);
+}
+
+DDS_TypeCode *
+TypeCache::shared_typecode(
+  const DDS_TCKind kind,
+  const DDS_UnsignedLong bound,
+  const DDS_TypeCode * const element_tc)
+{
+  const TypeCodeShape shape{kind, bound, element_tc};
+  std::lock_guard<std::mutex> lock(shared_tcs_mutex_);
+  auto shared = shared_tcs_.find(shape);
+  if (nullptr != shared) {
+    return *shared;
+  }
+  DDS_ExceptionCode_t ex = DDS_NO_EXCEPTION_CODE;
+  DDS_TypeCode * tc = nullptr;
+  switch (kind) {
+    case DDS_TK_STRING:
+      {
+        tc = DDS_TypeCodeFactory_create_string_tc(tc_factory_, bound, &ex);
+        break;
+      }
+    case DDS_TK_WSTRING:
+      {
+        tc = DDS_TypeCodeFactory_create_wstring_tc(tc_factory_, bound, &ex);
+        break;
+      }
+    case DDS_TK_SEQUENCE:
+      {
+        tc = DDS_TypeCodeFactory_create_sequence_tc(tc_factory_, bound, element_tc, &ex);
+        break;
+      }
+    case DDS_TK_ARRAY:
+      {
+        struct DDS_UnsignedLongSeq dimensions = DDS_SEQUENCE_INITIALIZER;
+        if (!DDS_UnsignedLongSeq_ensure_length(&dimensions, 1, 1)) {
+          throw std::runtime_error("failed to ensure sequence length");
+        }
+        *DDS_UnsignedLongSeq_get_reference(&dimensions, 0) = bound;
+        tc = DDS_TypeCodeFactory_create_array_tc(tc_factory_, &dimensions, element_tc, &ex);
+        DDS_UnsignedLongSeq_finalize(&dimensions);
+        break;
+      }
+    default:
+      {
+        throw std::runtime_error("unsupported shared typecode kind");
+      }
+  }
+  if (nullptr == tc || DDS_NO_EXCEPTION_CODE != ex) {
+    throw std::runtime_error("failed to create shared typecode");
+  }
+  insert(tc);
+  shared_tcs_.emplace(shape, tc);
+  return tc;
 }
 
 std::tuple<bool, bool, std::vector<const DDS_TypeCode *>, std::vector<const DDS_TypeCode *>>
@@ -164,7 +656,6 @@ TypeCache::assert_dds_topic(
   const bool ros_type,
   const std::string & demangled_ros_type)
 {
-  std::lock_guard<std::mutex> lock(cache_mutex_);
   bool new_type;
   std::vector<const DDS_TypeCode *> new_types;
   std::vector<const DDS_TypeCode *> existing_types;
@@ -184,25 +675,10 @@ TypeCache::assert_ros_topic(
   const std::string & topic_name,
   const std::string & type_fqname)
 {
-  std::lock_guard<std::mutex> lock(cache_mutex_);
-  bool request_reply;
-  bool is_request;
-  std::tie(request_reply, is_request) = is_type_requestreply(type_fqname);
-  const rosidl_message_type_support_t * intro_typesupport;
-  bool cpp_version;
-
-  std::tie(cpp_version, intro_typesupport) = load_typesupport(type_fqname);
-
+  bool new_type;
   std::vector<const DDS_TypeCode *> new_asserted;
   std::vector<const DDS_TypeCode *> already_asserted;
-  const bool new_type = assert_typecode(
-    type_fqname,
-    request_reply,
-    is_request,
-    cpp_version,
-    intro_typesupport,
-    new_asserted,
-    already_asserted);
+  std::tie(new_type, new_asserted, already_asserted) = assert_ros_type(type_fqname);
   auto topic_tc = (new_type) ? new_asserted.back() : already_asserted.back();
   DDS_ExceptionCode_t ex = DDS_NO_EXCEPTION_CODE;
   std::string tc_name = DDS_TypeCode_name(topic_tc, &ex);
@@ -218,15 +694,24 @@ TypeCache::insert_topic(
   const std::string & topic_name,
   const std::string & type_fqname)
 {
-  std::string norm_fqname = normalize_dds_type_name(type_fqname);
-  auto cached = topics_cache_.find(topic_name);
-  if (cached != topics_cache_.end()) {
-    if (norm_fqname != cached->second) {
+  const NameId norm_fqname = names_.normalized(type_fqname);
+  const NameId topic_id = names_.intern(topic_name);
+  std::lock_guard<std::mutex> lock(topics_mutex_);
+  auto cached = topics_cache_.emplace(topic_id, norm_fqname);
+  if (!cached.second) {
+    if (norm_fqname != *cached.first) {
       throw std::runtime_error("topic already asserted with a different type");
     }
     return false;
   }
-  topics_cache_.emplace(topic_name, norm_fqname);
+  if (nullptr != store_) {
+    const std::string_view stored_type = store_->topic_type(topic_name);
+    if (!stored_type.empty() && stored_type != names_.name(norm_fqname)) {
+      LOG(WARNING) << "type of topic " << topic_name <<
+        " changed since the cache file was saved: " << stored_type << " -> " <<
+        names_.name(norm_fqname) << std::endl;
+    }
+  }
   return true;
 }
 
@@ -236,7 +721,6 @@ TypeCache::assert_dds_type(
   const bool ros_type,
   const std::string & demangled_ros_type)
 {
-  std::lock_guard<std::mutex> lock(cache_mutex_);
   return assert_typecode(tc, ros_type, demangled_ros_type);
 }
 
@@ -253,97 +737,117 @@ TypeCache::assert_typecode(
   if (DDS_NO_EXCEPTION_CODE != ex) {
     throw std::runtime_error("failed to get typecode name");
   }
-  DDS_TypeCode * assert_tc = nullptr;
-  auto scope_exit_assert_tc =
-    rcpputils::make_scope_exit(
-    [this, &assert_tc]() {
-      if (nullptr != assert_tc) {
-        DDS_ExceptionCode_t ex = DDS_NO_EXCEPTION_CODE;
-        DDS_TypeCodeFactory_delete_tc(tc_factory_, assert_tc, &ex);
-      }
-    });
-
+  // When the type is (de)mangled, the names of all struct types and of
+  // their members are transformed.
+  TypeCodeMakeNameFn make_name_fn = nullptr;
+  TypeCodeMakeNameFn make_member_name_fn = nullptr;
   if (ros_type && !options_.demangle_ros_names && type_fqname == demangled_ros_type) {
-    assert_tc = mangle_typecode(tc);
-    type_fqname = DDS_TypeCode_name(assert_tc, &ex);
-    if (DDS_NO_EXCEPTION_CODE != ex) {
-      throw std::runtime_error("failed to get typecode name");
-    }
+    make_name_fn = make_typecode_name_mangled;
+    make_member_name_fn = make_typecode_member_name_mangled_fn(options_.legacy_rmw_compatible);
   } else if (ros_type && options_.demangle_ros_names && type_fqname != demangled_ros_type) {
-    assert_tc = demangle_typecode(tc);
-    type_fqname = DDS_TypeCode_name(assert_tc, &ex);
-    if (DDS_NO_EXCEPTION_CODE != ex) {
-      throw std::runtime_error("failed to get typecode name");
-    }
-  } else {
-    assert_tc = DDS_TypeCodeFactory_clone_tc(tc_factory_, tc, &ex);
-    if (nullptr == assert_tc || DDS_NO_EXCEPTION_CODE != ex) {
-      throw std::runtime_error("failed to get clone typecode");
-    }
+    make_name_fn = make_typecode_name_demangled;
+    make_member_name_fn = make_typecode_member_name_demangled;
+  }
+  if (nullptr != make_name_fn) {
+    type_fqname = make_name_fn(type_fqname);
   }
 
-  auto cached = find(type_fqname, ros_type);
-  if (nullptr != cached) {
-    if (!DDS_TypeCode_equal(cached, assert_tc, &ex)) {
-      // DDS_TypeCode_print_IDL(cached, 0, &ex);
-      // DDS_TypeCode_print_IDL(assert_tc, 0, &ex);
-      std::string msg = "conflict detected for asserted typecode: ";
-      msg += type_fqname;
-      throw std::runtime_error(msg);
+  // Fingerprint the type as it would be cached, so that it only needs to
+  // be copied if it is not in the cache yet (or to confirm a conflict).
+  TypeCodeFingerprinter fingerprinter(make_name_fn, make_member_name_fn);
+  const TypeCodeFingerprint assert_fp = fingerprinter.fingerprint(tc);
+  const CachedTypeCode cached =
+    find_or_load(type_fqname, ros_type, &assert_fp, new_asserted);
+  if (nullptr != cached.tc) {
+    if (cached.fp != assert_fp || !trust_fingerprint(ros_type)) {
+      // Names are only transformed for ROS types, other types can be
+      // compared without copying them.
+      DDS_TypeCode * assert_tc = nullptr;
+      if (nullptr != make_name_fn) {
+        assert_tc = copy_typecode(tc, make_name_fn, make_member_name_fn);
+      }
+      auto scope_exit_assert_tc =
+        rcpputils::make_scope_exit(
+        [this, assert_tc]() {
+          if (nullptr != assert_tc) {
+            DDS_ExceptionCode_t ex = DDS_NO_EXCEPTION_CODE;
+            DDS_TypeCodeFactory_delete_tc(tc_factory_, assert_tc, &ex);
+          }
+        });
+      if (!DDS_TypeCode_equal(cached.tc, (nullptr != assert_tc) ? assert_tc : tc, &ex)) {
+        // DDS_TypeCode_print_IDL(cached.tc, 0, &ex);
+        // DDS_TypeCode_print_IDL(assert_tc, 0, &ex);
+        std::string msg = "conflict detected for asserted typecode: ";
+        msg += type_fqname;
+        throw std::runtime_error(msg);
+      }
+    }
+    if (!new_asserted.empty() && new_asserted.back() == cached.tc) {
+      // Loaded from the cache file
+      return std::make_tuple(true, new_asserted, already_asserted);
     }
-    already_asserted.insert(already_asserted.end(), cached);
+    already_asserted.insert(already_asserted.end(), cached.tc);
     return std::make_tuple(false, new_asserted, already_asserted);
   }
-  DDS_TypeCode * clone_tc = DDS_TypeCodeFactory_clone_tc(tc_factory_, assert_tc, &ex);
-  auto scope_exit_clone_tc =
-    rcpputils::make_scope_exit(
-    [this, clone_tc]() {
-      DDS_ExceptionCode_t ex = DDS_NO_EXCEPTION_CODE;
-      if (nullptr != clone_tc) {
-        DDS_TypeCodeFactory_delete_tc(tc_factory_, clone_tc, &ex);
-      }
-    });
-  if (nullptr == clone_tc || DDS_NO_EXCEPTION_CODE != ex) {
-    throw std::runtime_error("failed to get typecode name");
-  }
 
-  std::vector<DDS_TypeCode *> nested = collect_nested_typecodes(clone_tc, ros_type);
-  auto scope_exit_nested =
-    rcpputils::make_scope_exit(
-    [this, &nested]() {
-      for (auto & n : nested) {
-        DDS_ExceptionCode_t ex = DDS_NO_EXCEPTION_CODE;
-        DDS_TypeCodeFactory_delete_tc(tc_factory_, n, &ex);
-      }
-    });
+  // Copy the type into the cache, which owns the copy from here on. Nested
+  // types are cached as references into the copy.
+  DDS_TypeCode * const assert_tc = copy_typecode(tc, make_name_fn, make_member_name_fn);
+  insert(assert_tc);
+
+  std::vector<CachedTypeCode> nested;
+  collect_nested_typecodes(tc, assert_tc, fingerprinter, ros_type, nested);
   for (auto & n : nested) {
-    std::string n_name = DDS_TypeCode_name(n, &ex);
+    std::string n_name = DDS_TypeCode_name(n.tc, &ex);
     if (DDS_NO_EXCEPTION_CODE != ex) {
       throw std::runtime_error("failed to get typecode name");
     }
-    auto cached = find(n_name, ros_type);
-    if (nullptr == cached) {
-      insert(n_name, n, ros_type);
-      new_asserted.insert(new_asserted.end(), n);
+    auto n_cached = insert(n_name, n.tc, ros_type, n.fp);
+    if (n_cached.tc == n.tc) {
+      new_asserted.insert(new_asserted.end(), n.tc);
     } else {
-      if (!DDS_TypeCode_equal(cached, n, &ex)) {
-        // DDS_TypeCode_print_IDL(cached, 0, &ex);
-        // DDS_TypeCode_print_IDL(n, 0, &ex);
+      if (!equal_to_cached(n_cached, n.tc, n.fp, ros_type)) {
+        // DDS_TypeCode_print_IDL(cached.tc, 0, &ex);
+        // DDS_TypeCode_print_IDL(n.tc, 0, &ex);
         std::string msg = "conflict detected for asserted nested typecode: ";
         msg += n_name;
         throw std::runtime_error(msg);
       }
-      already_asserted.insert(already_asserted.end(), n);
+      already_asserted.insert(already_asserted.end(), n_cached.tc);
     }
   }
-  insert(type_fqname, clone_tc, ros_type);
-  new_asserted.insert(new_asserted.end(), clone_tc);
-
-  scope_exit_nested.cancel();
-  scope_exit_clone_tc.cancel();
+  const CachedTypeCode root_cached = insert(type_fqname, assert_tc, ros_type, assert_fp);
+  if (root_cached.tc != assert_tc) {
+    // The type was asserted concurrently by another thread
+    if (!equal_to_cached(root_cached, assert_tc, assert_fp, ros_type)) {
+      std::string msg = "conflict detected for asserted typecode: ";
+      msg += type_fqname;
+      throw std::runtime_error(msg);
+    }
+    already_asserted.insert(already_asserted.end(), root_cached.tc);
+    return std::make_tuple(false, new_asserted, already_asserted);
+  }
+  new_asserted.insert(new_asserted.end(), assert_tc);
   return std::make_tuple(true, new_asserted, already_asserted);
 }
 
+DDS_TypeCode *
+TypeCache::copy_typecode(
+  const DDS_TypeCode * const tc,
+  TypeCodeMakeNameFn make_name_fn,
+  TypeCodeMakeNameFn make_member_name_fn)
+{
+  if (nullptr != make_name_fn) {
+    return mangle_typecode_recur(tc, make_name_fn, make_member_name_fn);
+  }
+  DDS_ExceptionCode_t ex = DDS_NO_EXCEPTION_CODE;
+  DDS_TypeCode * const copy_tc = DDS_TypeCodeFactory_clone_tc(tc_factory_, tc, &ex);
+  if (nullptr == copy_tc || DDS_NO_EXCEPTION_CODE != ex) {
+    throw std::runtime_error("failed to clone typecode");
+  }
+  return copy_tc;
+}
+
 DDS_TypeCode *
 TypeCache::resolve_collection_typecode(const DDS_TypeCode * const tc)
 {
@@ -363,145 +867,271 @@ TypeCache::resolve_collection_typecode(const DDS_TypeCode * const tc)
   }
 }
 
-std::vector<DDS_TypeCode *>
-TypeCache::collect_nested_typecodes(const DDS_TypeCode * const tc, const bool ros_type)
+const DDS_TypeCode *
+TypeCache::member_struct_typecode(const DDS_TypeCode * const tc, const DDS_UnsignedLong i)
 {
   DDS_ExceptionCode_t ex = DDS_NO_EXCEPTION_CODE;
-  std::vector<DDS_TypeCode *> result;
-  auto scope_exit_result =
-    rcpputils::make_scope_exit(
-    [this, &result]() {
-      for (auto & n : result) {
-        DDS_ExceptionCode_t ex = DDS_NO_EXCEPTION_CODE;
-        DDS_TypeCodeFactory_delete_tc(tc_factory_, n, &ex);
-      }
-    });
-  size_t member_count = DDS_TypeCode_member_count(tc, &ex);
+  DDS_TypeCode * member_tc = DDS_TypeCode_member_type(tc, i, &ex);
+  if (nullptr == member_tc || DDS_NO_EXCEPTION_CODE != ex) {
+    throw std::runtime_error("failed to get typecode member id");
+  }
+  auto tc_kind = DDS_TypeCode_kind(member_tc, &ex);
   if (DDS_NO_EXCEPTION_CODE != ex) {
-    throw std::runtime_error("failed to get typecode member count");
+    throw std::runtime_error("failed to get typecode kind");
   }
-  for (size_t i = 0; i < member_count; i++) {
-    DDS_TypeCode * member_tc = DDS_TypeCode_member_type(tc, i, &ex);
-    if (nullptr == member_tc || DDS_NO_EXCEPTION_CODE != ex) {
-      throw std::runtime_error("failed to get typecode member id");
-    }
-    auto tc_kind = DDS_TypeCode_kind(member_tc, &ex);
+  if (DDS_TK_STRUCT == tc_kind) {
+    return member_tc;
+  } else if (DDS_TK_SEQUENCE == tc_kind || DDS_TK_ARRAY == tc_kind) {
+    DDS_TypeCode * nested_tc = resolve_collection_typecode(member_tc);
+    auto collection_tc_k = DDS_TypeCode_kind(nested_tc, &ex);
     if (DDS_NO_EXCEPTION_CODE != ex) {
-      throw std::runtime_error("failed to get typecode kind");
+      throw std::runtime_error("failed to get collection typecode kind");
     }
-    DDS_TypeCode * nested_tc = nullptr;
-    if (DDS_TK_STRUCT == tc_kind) {
-      nested_tc = member_tc;
-    } else if (DDS_TK_SEQUENCE == tc_kind || DDS_TK_ARRAY == tc_kind) {
-      nested_tc = resolve_collection_typecode(member_tc);
-      auto collection_tc_k = DDS_TypeCode_kind(nested_tc, &ex);
+    if (DDS_TK_STRUCT == collection_tc_k) {
+      return nested_tc;
+    }
+  }
+  return nullptr;
+}
+
+void
+TypeCache::collect_nested_typecodes(
+  const DDS_TypeCode * const tc,
+  const DDS_TypeCode * const copy_tc,
+  TypeCodeFingerprinter & fingerprinter,
+  const bool ros_type,
+  std::vector<CachedTypeCode> & result)
+{
+  // Walk the type depth-first with an explicit stack, so that every nested
+  // type can be appended after its own dependencies. Types shared by
+  // multiple members (e.g. std_msgs::msg::Header) are only visited once.
+  struct Frame
+  {
+    const DDS_TypeCode * tc;
+    const DDS_TypeCode * copy_tc;
+    TypeCodeFingerprint fp;
+    DDS_UnsignedLong member_count;
+    DDS_UnsignedLong next_member;
+  };
+  DDS_ExceptionCode_t ex = DDS_NO_EXCEPTION_CODE;
+  std::unordered_map<std::string, TypeCodeFingerprint> visited;
+  std::vector<Frame> stack;
+  const auto push_frame =
+    [&stack, &ex](
+    const DDS_TypeCode * const tc,
+    const DDS_TypeCode * const copy_tc,
+    const TypeCodeFingerprint & fp)
+    {
+      const DDS_UnsignedLong member_count = DDS_TypeCode_member_count(tc, &ex);
       if (DDS_NO_EXCEPTION_CODE != ex) {
-        throw std::runtime_error("failed to get collection typecode kind");
+        throw std::runtime_error("failed to get typecode member count");
       }
-      if (DDS_TK_STRUCT != collection_tc_k) {
-        continue;
+      stack.push_back(Frame{tc, copy_tc, fp, member_count, 0});
+    };
+  push_frame(tc, copy_tc, TypeCodeFingerprint());
+  while (!stack.empty()) {
+    Frame & frame = stack.back();
+    if (frame.next_member == frame.member_count) {
+      // The root type is not a nested type
+      if (stack.size() > 1) {
+        CachedTypeCode entry;
+        entry.tc = frame.copy_tc;
+        entry.fp = frame.fp;
+        result.insert(result.end(), entry);
       }
-    } else {
+      stack.pop_back();
       continue;
     }
-    std::vector<DDS_TypeCode *> nested = collect_nested_typecodes(nested_tc, ros_type);
-    auto scope_exit_nested =
-      rcpputils::make_scope_exit(
-      [this, &nested]() {
-        for (auto & n : nested) {
-          DDS_ExceptionCode_t ex = DDS_NO_EXCEPTION_CODE;
-          DDS_TypeCodeFactory_delete_tc(tc_factory_, n, &ex);
-        }
-      });
-    result.insert(result.end(), nested.begin(), nested.end());
-    scope_exit_nested.cancel();
-    std::string nested_name = DDS_TypeCode_name(nested_tc, &ex);
+    const DDS_UnsignedLong i = frame.next_member++;
+    const DDS_TypeCode * const nested_tc = member_struct_typecode(frame.tc, i);
+    if (nullptr == nested_tc) {
+      continue;
+    }
+    const DDS_TypeCode * const copy_nested_tc = member_struct_typecode(frame.copy_tc, i);
+    if (nullptr == copy_nested_tc) {
+      throw std::runtime_error("failed to get nested typecode of copy");
+    }
+    std::string nested_name = DDS_TypeCode_name(copy_nested_tc, &ex);
     if (DDS_NO_EXCEPTION_CODE != ex) {
       throw std::runtime_error("failed to get typecode name");
     }
-    auto already_cached = find(nested_name, ros_type);
-    if (nullptr == already_cached) {
-      DDS_TypeCode * cloned = DDS_TypeCodeFactory_clone_tc(tc_factory_, nested_tc, &ex);
-      if (nullptr == cloned) {
-        throw std::runtime_error("failed to clone typecode");
+    // The copy was fingerprinted through the original type
+    const TypeCodeFingerprint nested_fp = fingerprinter.fingerprint(nested_tc);
+    auto visited_fp = visited.emplace(nested_name, nested_fp);
+    if (!visited_fp.second) {
+      if (visited_fp.first->second != nested_fp) {
+        std::string msg = "conflict detected for asserted nested typecode: ";
+        msg += nested_name;
+        throw std::runtime_error(msg);
       }
-      auto scope_exit_clone_tc =
-        rcpputils::make_scope_exit(
-        [this, cloned]() {
-          DDS_ExceptionCode_t ex = DDS_NO_EXCEPTION_CODE;
-          if (nullptr != cloned) {
-            DDS_TypeCodeFactory_delete_tc(tc_factory_, cloned, &ex);
-          }
-        });
-      result.insert(result.end(), cloned);
-      scope_exit_clone_tc.cancel();
+      continue;
+    }
+    // Types are cached after all of their nested types, so there is no
+    // need to walk the members of a type which is already cached.
+    if (nullptr != find(nested_name, ros_type)) {
+      continue;
     }
+    push_frame(nested_tc, copy_nested_tc, nested_fp);
   }
-  scope_exit_result.cancel();
-  return result;
 }
 
 std::pair<bool, const rosidl_message_type_support_t *>
 TypeCache::load_typesupport(const std::string & type_fqname)
 {
+  const NameId type_id = names_.intern(type_fqname);
+  const auto now = std::chrono::steady_clock::now();
+  {
+    std::lock_guard<std::mutex> lock(typesupport_failures_mutex_);
+    auto failed = typesupport_failures_.find(type_id);
+    if (nullptr != failed && now - *failed < options_.negative_cache_ttl) {
+      typesupport_failures_avoided_ += 1;
+      throw TypesupportNotFoundException("type support recently not found: " + type_fqname);
+    }
+  }
+  bool own_failure = false;
+  try {
+    return load_typesupport_uncached(type_fqname, own_failure);
+  } catch (TypesupportNotFoundException & e) {
+    // A package which failed to load for another thread is not remembered
+    // as a failure of this type.
+    if (!own_failure) {
+      throw;
+    }
+    std::lock_guard<std::mutex> lock(typesupport_failures_mutex_);
+    auto failed = typesupport_failures_.emplace(type_id, now);
+    if (!failed.second) {
+      *failed.first = now;
+    }
+    throw;
+  }
+}
+
+std::pair<bool, const rosidl_message_type_support_t *>
+TypeCache::load_typesupport_uncached(const std::string & type_fqname, bool & own_failure)
+{
+  own_failure = false;
   std::string demangled_type_fqname = demangle_dds_type_name(type_fqname);
   std::string package_name;
   std::string middle_module;
   std::string type_name;
   std::tie(package_name, middle_module, type_name) =
     parse_ros_type_name(demangled_type_fqname);
-  bool cpp_version = false;
-  std::shared_ptr<rcpputils::SharedLibrary> typesupport_lib;
-  const rosidl_message_type_support_t * typesupport = nullptr;
-  auto cached_lib = typesupports_c_.find(package_name);
-  bool already_cached = cached_lib != typesupports_c_.end();
-  if (!already_cached) {
-    cpp_version = true;
-    cached_lib = typesupports_cpp_.find(package_name);
-    already_cached = cached_lib != typesupports_cpp_.end();
-  }
-  if (already_cached) {
+  std::shared_future<std::vector<TypesupportLibrary>> loaded;
+  std::promise<std::vector<TypesupportLibrary>> loading;
+  bool loader = false;
+  {
+    std::lock_guard<std::mutex> lock(typesupports_mutex_);
+    const size_t package_hash = typesupports_.hash(package_name);
+    auto cached_lib = typesupports_.find(package_name, package_hash);
+    if (nullptr != cached_lib && cached_lib->valid()) {
+      loaded = *cached_lib;
+    } else {
+      loaded = loading.get_future().share();
+      loader = true;
+      if (nullptr != cached_lib) {
+        *cached_lib = loaded;
+      } else {
+        typesupports_.emplace(package_name, loaded, package_hash);
+      }
+    }
+  }
+
+  if (loader) {
+    // Only loading the package's libraries is shared with other threads:
+    // whether they contain a type is up to each caller to find out.
+    std::vector<TypesupportLibrary> libs;
     try {
-      std::tie(std::ignore, typesupport_lib) = *cached_lib;
-      typesupport = lookup_introspection_typesupport(
-        package_name, middle_module, type_name, *typesupport_lib, cpp_version);
+      for (auto & opened :
+        open_introspection_typesupport_libraries(package_name, typesupport_resolver_))
+      {
+        libs.push_back({opened.first, std::move(opened.second)});
+      }
     } catch (std::exception & e) {
-      already_cached = false;
+      own_failure = true;
+      loading.set_exception(std::current_exception());
+      std::lock_guard<std::mutex> lock(typesupports_mutex_);
+      auto cached_lib = typesupports_.find(package_name);
+      if (nullptr != cached_lib) {
+        *cached_lib = std::shared_future<std::vector<TypesupportLibrary>>();
+      }
+      throw;
     }
+    loading.set_value(std::move(libs));
   }
-  if (!already_cached) {
-    std::tie(cpp_version, typesupport_lib, typesupport) =
-      load_instrospection_typesupport_library(
-      package_name, middle_module, type_name, lib_path_);
-    auto & typesupport_cache = (cpp_version) ? typesupports_cpp_ : typesupports_c_;
-    bool duplicate =
-      typesupport_cache.find(package_name) != typesupport_cache.end();
-    if (duplicate) {
-      throw std::runtime_error("multiple copies of the same shared library");
+
+  // Wait for the libraries to be loaded by another thread (rethrowing its
+  // error if it failed), then look up the type in them.
+  const std::vector<TypesupportLibrary> & libs = loaded.get();
+  own_failure = true;
+  for (const auto & lib : libs) {
+    try {
+      const rosidl_message_type_support_t * const typesupport =
+        lookup_introspection_typesupport(
+        package_name, middle_module, type_name, *lib.lib, lib.cpp_version);
+      if (nullptr != typesupport) {
+        return {lib.cpp_version, typesupport};
+      }
+    } catch (TypesupportNotFoundException & e) {
+      LOG(DEBUG) << "type support not found in " << package_name << " library: " <<
+        e.what() << std::endl;
     }
-    typesupport_cache.emplace(package_name, typesupport_lib);
-  }
-  if (nullptr == typesupport) {
-    throw std::runtime_error("failed to load type support");
   }
-
-  return {cpp_version, typesupport};
+  throw TypesupportNotFoundException("failed to load type support: " + type_fqname);
 }
 
 std::tuple<bool, std::vector<const DDS_TypeCode *>, std::vector<const DDS_TypeCode *>>
 TypeCache::assert_ros_type(const std::string & type_fqname)
 {
-  std::lock_guard<std::mutex> lock(cache_mutex_);
   bool request_reply;
   bool is_request;
   std::tie(request_reply, is_request) = is_type_requestreply(type_fqname);
   const rosidl_message_type_support_t * intro_typesupport;
   bool cpp_version;
 
-  std::tie(cpp_version, intro_typesupport) = load_typesupport(type_fqname);
-
+  // Don't load the type support library if the type is already cached, or
+  // if it can be loaded from the cache file.
   std::vector<const DDS_TypeCode *> new_asserted;
   std::vector<const DDS_TypeCode *> already_asserted;
+  const CachedTypeCode cached =
+    find_or_load(ros_type_cache_name(type_fqname), true, nullptr, new_asserted);
+  if (nullptr != cached.tc) {
+    if (!new_asserted.empty() && new_asserted.back() == cached.tc) {
+      return std::make_tuple(true, new_asserted, already_asserted);
+    }
+    already_asserted.insert(already_asserted.end(), cached.tc);
+    return std::make_tuple(false, new_asserted, already_asserted);
+  }
+
+  // Messages of the core packages are compiled into the library. They are
+  // asserted like DDS types, so that they are (de)mangled as needed, once
+  // converted to the same form as the types converted from type support.
+  if (!request_reply && options_.core_typecodes) {
+    const std::string core_type_fqname = normalize_dds_type_name(type_fqname);
+    const DDS_TypeCode * const core_tc = find_core_typecode(core_type_fqname);
+    if (nullptr != core_tc) {
+      std::unordered_map<const DDS_TypeCode *, const DDS_TypeCode *> normalized;
+      std::vector<DDS_TypeCode *> created;
+      auto scope_exit_created =
+        rcpputils::make_scope_exit(
+        [this, &created]()
+        {
+          DDS_ExceptionCode_t ex = DDS_NO_EXCEPTION_CODE;
+          for (auto created_tc = created.rbegin(); created_tc != created.rend(); ++created_tc) {
+            DDS_TypeCodeFactory_delete_tc(tc_factory_, *created_tc, &ex);
+          }
+        });
+      const DDS_TypeCode * const normalized_tc =
+        normalize_core_typecode(core_tc, normalized, created);
+      if (nullptr != normalized_tc) {
+        return assert_typecode(normalized_tc, true, core_type_fqname);
+      }
+      LOG(DEBUG) << "core typecode not used, it can't match type support: " <<
+        core_type_fqname << std::endl;
+    }
+  }
+
+  std::tie(cpp_version, intro_typesupport) = load_typesupport(type_fqname);
+
   const bool new_type = assert_typecode(
     type_fqname,
     request_reply,
@@ -524,19 +1154,14 @@ TypeCache::assert_typecode(
   std::vector<const DDS_TypeCode *> & already_asserted,
   const bool root)
 {
-  std::string assert_type_fqname;
-  // type_fqname is assumed to be a "demangled" type name, i.e. in the form
-  // "<package>::<middle>::<type>". Check if we are caching types using
-  // mangled names and if so, tranform it.
-  if (!options_.demangle_ros_names) {
-    assert_type_fqname = make_typecode_name_mangled(type_fqname);
-  } else {
-    assert_type_fqname = normalize_dds_type_name(type_fqname);
-  }
+  const std::string assert_type_fqname = ros_type_cache_name(type_fqname);
 
-  auto cached = find(assert_type_fqname, true);
-  if (nullptr != cached) {
-    already_asserted.insert(already_asserted.end(), cached);
+  auto cached = find_or_load(assert_type_fqname, true, nullptr, new_asserted);
+  if (nullptr != cached.tc) {
+    if (!new_asserted.empty() && new_asserted.back() == cached.tc) {
+      return true;
+    }
+    already_asserted.insert(already_asserted.end(), cached.tc);
     return false;
   }
 
@@ -560,20 +1185,13 @@ TypeCache::assert_typecode(
       already_asserted,
       root);
   }
+  // Member names are owned by the arena, and the factory copies the
+  // members into the new typecode.
   struct DDS_StructMemberSeq * const tc_members_ptr = &tc_members;
   auto scope_exit_tc_members_delete =
     rcpputils::make_scope_exit(
     [tc_members_ptr]()
     {
-      const DDS_Long seq_len =
-      DDS_StructMemberSeq_get_length(tc_members_ptr);
-      for (DDS_Long i = 0; i < seq_len; i++) {
-        DDS_StructMember * const tc_member =
-        DDS_StructMemberSeq_get_reference(tc_members_ptr, i);
-        DDS_String_free(tc_member->name);
-        tc_member->name = nullptr;
-      }
-
       DDS_StructMemberSeq_finalize(tc_members_ptr);
     });
 
@@ -595,11 +1213,16 @@ TypeCache::assert_typecode(
       DDS_TypeCodeFactory_delete_tc(tc_factory_, tc, &ex);
     });
 
-  insert(assert_type_fqname, tc, true);
-  new_asserted.insert(new_asserted.end(), tc);
-
   scope_exit_tc.cancel();
-  scope_exit_tc_members_delete.cancel();
+  insert(tc);
+  auto cached_tc = insert(assert_type_fqname, tc, true);
+  if (cached_tc.tc != tc) {
+    // The type was asserted concurrently by another thread. Both were
+    // generated from the same type support, so they must be equal.
+    already_asserted.insert(already_asserted.end(), cached_tc.tc);
+    return false;
+  }
+  new_asserted.insert(new_asserted.end(), tc);
   return true;
 }
 
@@ -610,18 +1233,7 @@ TypeCache::mangle_typecode(const DDS_TypeCode * const tc)
   return mangle_typecode_recur(
     tc,
     make_typecode_name_mangled,
-    static_cast<TypeCodeMakeNameFn>(
-      ((options_.legacy_rmw_compatible)?
-        [](const std::string & member_name) {
-          return make_typecode_member_name_mangled(
-            member_name, true /* legacy_rmw_compatible */);
-        } :
-        [](const std::string & member_name) {
-          return make_typecode_member_name_mangled(
-            member_name, false /* legacy_rmw_compatible */);
-        })
-      )
-    );
+    make_typecode_member_name_mangled_fn(options_.legacy_rmw_compatible));
 }
 
 DDS_TypeCode *
@@ -634,50 +1246,49 @@ TypeCache::demangle_typecode(const DDS_TypeCode * const tc)
 }
 
 std::vector<const DDS_TypeCode *>
-TypeCache::extract_nested_typecodes(
-  const DDS_TypeCode * const tc,
-  std::vector<const DDS_TypeCode *> * tc_cache)
+TypeCache::extract_nested_typecodes(const DDS_TypeCode * const tc)
 {
-  std::vector<const DDS_TypeCode *> stack_tc_cache;
-  if (nullptr == tc_cache) {
-    tc_cache = &stack_tc_cache;
-  }
-  if (std::find(tc_cache->begin(), tc_cache->end(), tc) == tc_cache->end()) {
-    tc_cache->insert(tc_cache->begin(), tc);
-  }
+  struct Frame
+  {
+    const DDS_TypeCode * tc;
+    DDS_UnsignedLong member_count;
+    DDS_UnsignedLong next_member;
+  };
   DDS_ExceptionCode_t ex = DDS_NO_EXCEPTION_CODE;
-  size_t member_count = DDS_TypeCode_member_count(tc, &ex);
-  if (DDS_NO_EXCEPTION_CODE != ex) {
-    throw std::runtime_error("failed to get typecode member count");
-  }
-  for (size_t i = 0; i < member_count; i++) {
-    DDS_TypeCode * member_tc = DDS_TypeCode_member_type(tc, i, &ex);
-    if (nullptr == member_tc || DDS_NO_EXCEPTION_CODE != ex) {
-      throw std::runtime_error("failed to get typecode member id");
-    }
-    auto tc_kind = DDS_TypeCode_kind(member_tc, &ex);
-    if (DDS_NO_EXCEPTION_CODE != ex) {
-      throw std::runtime_error("failed to get typecode kind");
-    }
-    DDS_TypeCode * nested_tc = nullptr;
-    if (DDS_TK_STRUCT == tc_kind) {
-      nested_tc = member_tc;
-    } else if (DDS_TK_SEQUENCE == tc_kind || DDS_TK_ARRAY == tc_kind) {
-      nested_tc = resolve_collection_typecode(member_tc);
-      auto collection_tc_k = DDS_TypeCode_kind(nested_tc, &ex);
+  std::unordered_set<std::string> visited;
+  std::vector<Frame> stack;
+  std::vector<const DDS_TypeCode *> result;
+  const auto visit =
+    [&stack, &visited, &ex](const DDS_TypeCode * const tc)
+    {
+      std::string tc_name = DDS_TypeCode_name(tc, &ex);
       if (DDS_NO_EXCEPTION_CODE != ex) {
-        throw std::runtime_error("failed to get collection typecode kind");
+        throw std::runtime_error("failed to get typecode name");
       }
-      if (DDS_TK_STRUCT != collection_tc_k) {
-        continue;
+      if (!visited.insert(std::move(tc_name)).second) {
+        return;
       }
-    } else {
+      const DDS_UnsignedLong member_count = DDS_TypeCode_member_count(tc, &ex);
+      if (DDS_NO_EXCEPTION_CODE != ex) {
+        throw std::runtime_error("failed to get typecode member count");
+      }
+      stack.push_back(Frame{tc, member_count, 0});
+    };
+  visit(tc);
+  while (!stack.empty()) {
+    Frame & frame = stack.back();
+    if (frame.next_member == frame.member_count) {
+      // Append the type after all of its dependencies
+      result.insert(result.end(), frame.tc);
+      stack.pop_back();
       continue;
     }
-    extract_nested_typecodes(nested_tc, tc_cache);
+    const DDS_TypeCode * const nested_tc = member_struct_typecode(frame.tc, frame.next_member++);
+    if (nullptr != nested_tc) {
+      visit(nested_tc);
+    }
   }
-
-  return stack_tc_cache;
+  return result;
 }
 
 DDS_TypeCode*
@@ -834,4 +1445,163 @@ TypeCache::mangle_typecode_recur(
   scope_exit_tc_members_delete.cancel();
   return result;
 }
+
+const DDS_TypeCode *
+TypeCache::normalize_core_typecode(
+  const DDS_TypeCode * const tc,
+  std::unordered_map<const DDS_TypeCode *, const DDS_TypeCode *> & normalized,
+  std::vector<DDS_TypeCode *> & created)
+{
+  auto cached = normalized.find(tc);
+  if (normalized.end() != cached) {
+    return cached->second;
+  }
+  DDS_ExceptionCode_t ex = DDS_NO_EXCEPTION_CODE;
+  const DDS_TCKind tc_kind = DDS_TypeCode_kind(tc, &ex);
+  if (DDS_NO_EXCEPTION_CODE != ex) {
+    throw std::runtime_error("failed to get typecode kind");
+  }
+  const DDS_TypeCode * result = nullptr;
+  switch (tc_kind) {
+    case DDS_TK_BOOLEAN:
+    case DDS_TK_OCTET:
+    case DDS_TK_CHAR:
+    case DDS_TK_FLOAT:
+    case DDS_TK_DOUBLE:
+    case DDS_TK_SHORT:
+    case DDS_TK_USHORT:
+    case DDS_TK_LONG:
+    case DDS_TK_ULONG:
+    case DDS_TK_LONGLONG:
+    case DDS_TK_ULONGLONG:
+      {
+        // Primitive typecodes are singletons
+        result = DDS_TypeCodeFactory_get_primitive_tc(tc_factory_, tc_kind);
+        break;
+      }
+    case DDS_TK_STRING:
+    case DDS_TK_WSTRING:
+      {
+        result = tc;
+        break;
+      }
+    case DDS_TK_ALIAS:
+    case DDS_TK_SEQUENCE:
+    case DDS_TK_ARRAY:
+      {
+        const DDS_TypeCode * const content_tc = DDS_TypeCode_content_type(tc, &ex);
+        if (nullptr == content_tc || DDS_NO_EXCEPTION_CODE != ex) {
+          throw std::runtime_error("failed to get collection typecode");
+        }
+        const DDS_TypeCode * const normalized_content_tc =
+          normalize_core_typecode(content_tc, normalized, created);
+        if (DDS_TK_ALIAS == tc_kind || nullptr == normalized_content_tc) {
+          result = normalized_content_tc;
+          break;
+        } else if (normalized_content_tc == content_tc) {
+          result = tc;
+          break;
+        }
+        DDS_TypeCode * collection_tc = nullptr;
+        if (DDS_TK_SEQUENCE == tc_kind) {
+          const DDS_UnsignedLong seq_bound = DDS_TypeCode_length(tc, &ex);
+          if (DDS_NO_EXCEPTION_CODE != ex) {
+            throw std::runtime_error("failed to get sequence bound");
+          }
+          collection_tc = DDS_TypeCodeFactory_create_sequence_tc(
+            tc_factory_, seq_bound, normalized_content_tc, &ex);
+        } else {
+          DDS_UnsignedLongSeq array_dimensions = DDS_SEQUENCE_INITIALIZER;
+          DDS_UnsignedLongSeq * const array_dimensions_ptr = &array_dimensions;
+          auto scope_exit_array_dims =
+            rcpputils::make_scope_exit(
+            [array_dimensions_ptr]()
+            {
+              DDS_UnsignedLongSeq_finalize(array_dimensions_ptr);
+            });
+          const DDS_UnsignedLong dim_count = DDS_TypeCode_array_dimension_count(tc, &ex);
+          if (DDS_NO_EXCEPTION_CODE != ex) {
+            throw std::runtime_error("failed to get array dimension count");
+          }
+          if (!DDS_UnsignedLongSeq_ensure_length(&array_dimensions, dim_count, dim_count)) {
+            throw std::runtime_error("failed to resize sequence");
+          }
+          for (DDS_UnsignedLong i = 0; i < dim_count; i++) {
+            *DDS_UnsignedLongSeq_get_reference(&array_dimensions, i) =
+              DDS_TypeCode_array_dimension(tc, i, &ex);
+            if (DDS_NO_EXCEPTION_CODE != ex) {
+              throw std::runtime_error("failed to get array dimension");
+            }
+          }
+          collection_tc = DDS_TypeCodeFactory_create_array_tc(
+            tc_factory_, &array_dimensions, normalized_content_tc, &ex);
+        }
+        if (nullptr == collection_tc || DDS_NO_EXCEPTION_CODE != ex) {
+          throw std::runtime_error("failed to create collection typecode");
+        }
+        created.push_back(collection_tc);
+        result = collection_tc;
+        break;
+      }
+    case DDS_TK_STRUCT:
+      {
+        const char * const tc_name = DDS_TypeCode_name(tc, &ex);
+        if (nullptr == tc_name || DDS_NO_EXCEPTION_CODE != ex) {
+          throw std::runtime_error("failed to get typecode name");
+        }
+        const DDS_UnsignedLong member_count = DDS_TypeCode_member_count(tc, &ex);
+        if (DDS_NO_EXCEPTION_CODE != ex) {
+          throw std::runtime_error("failed to get typecode member count");
+        }
+        struct DDS_StructMemberSeq tc_members = DDS_SEQUENCE_INITIALIZER;
+        struct DDS_StructMemberSeq * const tc_members_ptr = &tc_members;
+        auto scope_exit_tc_members_delete =
+          rcpputils::make_scope_exit(
+          [tc_members_ptr]()
+          {
+            DDS_StructMemberSeq_finalize(tc_members_ptr);
+          });
+        if (!DDS_StructMemberSeq_ensure_length(&tc_members, member_count, member_count)) {
+          throw std::runtime_error("failed to ensure sequence length");
+        }
+        bool supported = true;
+        for (DDS_UnsignedLong i = 0; i < member_count && supported; i++) {
+          const DDS_TypeCode * const member_tc = DDS_TypeCode_member_type(tc, i, &ex);
+          if (nullptr == member_tc || DDS_NO_EXCEPTION_CODE != ex) {
+            throw std::runtime_error("failed to get typecode member type");
+          }
+          const char * const member_name = DDS_TypeCode_member_name(tc, i, &ex);
+          if (nullptr == member_name || DDS_NO_EXCEPTION_CODE != ex) {
+            throw std::runtime_error("failed to get member name");
+          }
+          const DDS_TypeCode * const normalized_member_tc =
+            normalize_core_typecode(member_tc, normalized, created);
+          supported = nullptr != normalized_member_tc;
+          // The factory copies the members into the new typecode
+          DDS_StructMember * const tc_member = DDS_StructMemberSeq_get_reference(&tc_members, i);
+          tc_member->name = const_cast<char *>(member_name);
+          tc_member->type = const_cast<DDS_TypeCode *>(normalized_member_tc);
+        }
+        if (!supported) {
+          break;
+        }
+        DDS_TypeCode * const struct_tc =
+          DDS_TypeCodeFactory_create_struct_tc(tc_factory_, tc_name, &tc_members, &ex);
+        if (nullptr == struct_tc || DDS_NO_EXCEPTION_CODE != ex) {
+          throw std::runtime_error("failed to create struct typecode");
+        }
+        created.push_back(struct_tc);
+        result = struct_tc;
+        break;
+      }
+    default:
+      {
+        // e.g. enums, unions, or the int8/uint8 kinds, which type support
+        // never maps to
+        break;
+      }
+  }
+  normalized.emplace(tc, result);
+  return result;
+}
 }  // namespace robotspy
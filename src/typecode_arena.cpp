@@ -0,0 +1,100 @@
+// (c) 2023 Copyright, Real-Time Innovations, Inc.  All rights reserved.
+//
+// RTI grants Licensee a license to use, modify, compile, and create derivative
+// works of the Software.  Licensee has the right to distribute object form
+// only for use with RTI products.  The Software is provided "as is", with no
+// warranty of any type, including any warranty for fitness for any purpose.
+// RTI is under no obligation to maintain or support the Software.  RTI shall
+// not be liable for any incidental or consequential damages arising out of the
+// use or inability to use the software.
+#include <cstring>
+
+#include "robotspy/typecode_arena.hpp"
+
+namespace robotspy
+{
+TypeCodeArena::TypeCodeArena(DDS_TypeCodeFactory * const tc_factory)
+: tc_factory_(tc_factory)
+{}
+
+TypeCodeArena::~TypeCodeArena()
+{
+  release();
+}
+
+void
+TypeCodeArena::adopt(DDS_TypeCode * const tc)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  const size_t block_i = typecodes_ / TYPECODE_BLOCK_SIZE;
+  if (block_i == typecode_blocks_.size()) {
+    typecode_blocks_.emplace_back(new DDS_TypeCode *[TYPECODE_BLOCK_SIZE]);
+  }
+  typecode_blocks_[block_i][typecodes_ % TYPECODE_BLOCK_SIZE] = tc;
+  typecodes_ += 1;
+}
+
+char *
+TypeCodeArena::strdup(const std::string_view & str)
+{
+  const size_t len = str.length() + 1;
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (len > string_available_) {
+    // Strings which don't fit in a regular block get a dedicated one, so
+    // that the rest of the current block isn't wasted.
+    const size_t block_size = (len > STRING_BLOCK_SIZE / 4) ? len : STRING_BLOCK_SIZE;
+    string_blocks_.emplace_back(new char[block_size]);
+    string_reserved_bytes_ += block_size;
+    if (block_size == len) {
+      char * const result = string_blocks_.back().get();
+      memcpy(result, str.data(), str.length());
+      result[str.length()] = '\0';
+      string_bytes_ += len;
+      return result;
+    }
+    string_next_ = string_blocks_.back().get();
+    string_available_ = block_size;
+  }
+  char * const result = string_next_;
+  memcpy(result, str.data(), str.length());
+  result[str.length()] = '\0';
+  string_next_ += len;
+  string_available_ -= len;
+  string_bytes_ += len;
+  return result;
+}
+
+bool
+TypeCodeArena::release()
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  bool ok = true;
+  for (size_t i = 0; i < typecodes_; i++) {
+    DDS_ExceptionCode_t ex = DDS_NO_EXCEPTION_CODE;
+    DDS_TypeCodeFactory_delete_tc(
+      tc_factory_, typecode_blocks_[i / TYPECODE_BLOCK_SIZE][i % TYPECODE_BLOCK_SIZE], &ex);
+    ok = ok && DDS_NO_EXCEPTION_CODE == ex;
+  }
+  typecode_blocks_.clear();
+  typecodes_ = 0;
+  string_blocks_.clear();
+  string_next_ = nullptr;
+  string_available_ = 0;
+  string_bytes_ = 0;
+  string_reserved_bytes_ = 0;
+  return ok;
+}
+
+TypeCodeArenaStats
+TypeCodeArena::stats() const
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  TypeCodeArenaStats stats;
+  stats.typecodes = typecodes_;
+  stats.string_bytes = string_bytes_;
+  stats.string_reserved_bytes = string_reserved_bytes_;
+  stats.typecode_reserved_bytes =
+    typecode_blocks_.size() * TYPECODE_BLOCK_SIZE * sizeof(DDS_TypeCode *);
+  return stats;
+}
+}  // namespace robotspy
@@ -0,0 +1,338 @@
+// (c) 2023 Copyright, Real-Time Innovations, Inc.  All rights reserved.
+//
+// RTI grants Licensee a license to use, modify, compile, and create derivative
+// works of the Software.  Licensee has the right to distribute object form
+// only for use with RTI products.  The Software is provided "as is", with no
+// warranty of any type, including any warranty for fitness for any purpose.
+// RTI is under no obligation to maintain or support the Software.  RTI shall
+// not be liable for any incidental or consequential damages arising out of the
+// use or inability to use the software.
+#include <cstring>
+#include <stdexcept>
+
+#include "robotspy/typecode_fingerprint.hpp"
+
+namespace robotspy
+{
+// Two independent 64-bit lanes: FNV-1a, and a multiply/xorshift lane.
+class FingerprintHasher
+{
+public:
+  void
+  update(const void * const data, const size_t len)
+  {
+    const uint8_t * const bytes = static_cast<const uint8_t *>(data);
+    for (size_t i = 0; i < len; i++) {
+      lo_ ^= bytes[i];
+      lo_ *= 0x100000001b3ULL;
+      hi_ += bytes[i];
+      hi_ *= 0x9e3779b97f4a7c15ULL;
+      hi_ ^= hi_ >> 29;
+    }
+  }
+
+  void
+  update(const uint32_t value)
+  {
+    update(&value, sizeof(value));
+  }
+
+  void
+  update(const char * const str)
+  {
+    // Include the terminator so that ("ab", "c") != ("a", "bc")
+    update(str, strlen(str) + 1);
+  }
+
+  void
+  update(const std::string & str)
+  {
+    update(str.c_str(), str.length() + 1);
+  }
+
+  void
+  update(const TypeCodeFingerprint & fp)
+  {
+    update(&fp.hi, sizeof(fp.hi));
+    update(&fp.lo, sizeof(fp.lo));
+  }
+
+  TypeCodeFingerprint
+  digest() const
+  {
+    TypeCodeFingerprint fp;
+    fp.hi = hi_;
+    fp.lo = lo_;
+    return fp;
+  }
+
+private:
+  uint64_t hi_{0x6a09e667f3bcc908ULL};
+  uint64_t lo_{0xcbf29ce484222325ULL};
+};
+
+TypeCodeFingerprint
+TypeCodeFingerprinter::fingerprint(const DDS_TypeCode * const tc)
+{
+  size_t back_ref_depth = NO_BACK_REF;
+  return fingerprint(tc, back_ref_depth);
+}
+
+TypeCodeFingerprint
+TypeCodeFingerprinter::fingerprint(
+  const DDS_TypeCode * const tc,
+  size_t & back_ref_depth)
+{
+  back_ref_depth = NO_BACK_REF;
+  auto memoized = memo_.find(tc);
+  if (memo_.end() != memoized) {
+    return memoized->second;
+  }
+  // A type which is still being fingerprinted is a reference back to one of
+  // the enclosing types (e.g. struct Node { sequence<Node> children; }).
+  // Hash its distance from the current type instead of recursing again.
+  auto in_progress = in_progress_.find(tc);
+  if (in_progress_.end() != in_progress) {
+    back_ref_depth = in_progress->second;
+    FingerprintHasher hasher;
+    hasher.update(static_cast<uint32_t>(BACK_REF_MARKER));
+    hasher.update(static_cast<uint32_t>(in_progress_.size() - in_progress->second));
+    return hasher.digest();
+  }
+  const size_t depth = in_progress_.size();
+  in_progress_.emplace(tc, depth);
+  size_t min_back_ref_depth = NO_BACK_REF;
+
+  DDS_ExceptionCode_t ex = DDS_NO_EXCEPTION_CODE;
+  const DDS_TCKind tc_kind = DDS_TypeCode_kind(tc, &ex);
+  if (DDS_NO_EXCEPTION_CODE != ex) {
+    in_progress_.erase(tc);
+    throw std::runtime_error("failed to get typecode kind");
+  }
+  FingerprintHasher hasher;
+  hasher.update(static_cast<uint32_t>(tc_kind));
+
+  try {
+    hash_typecode(tc, tc_kind, hasher, min_back_ref_depth);
+  } catch (...) {
+    in_progress_.erase(tc);
+    throw;
+  }
+  in_progress_.erase(tc);
+
+  const TypeCodeFingerprint fp = hasher.digest();
+  back_ref_depth = min_back_ref_depth;
+  if (min_back_ref_depth > depth) {
+    // Types which are part of a cycle are not memoized, since their
+    // fingerprint depends on which type of the cycle was entered first.
+    memo_.emplace(tc, fp);
+  }
+  return fp;
+}
+
+TypeCodeFingerprint
+TypeCodeFingerprinter::nested_fingerprint(
+  const DDS_TypeCode * const tc,
+  size_t & min_back_ref_depth)
+{
+  size_t back_ref_depth = NO_BACK_REF;
+  const TypeCodeFingerprint fp = fingerprint(tc, back_ref_depth);
+  if (back_ref_depth < min_back_ref_depth) {
+    min_back_ref_depth = back_ref_depth;
+  }
+  return fp;
+}
+
+void
+TypeCodeFingerprinter::hash_typecode(
+  const DDS_TypeCode * const tc,
+  const DDS_TCKind tc_kind,
+  FingerprintHasher & hasher,
+  size_t & min_back_ref_depth)
+{
+  DDS_ExceptionCode_t ex = DDS_NO_EXCEPTION_CODE;
+  switch (tc_kind) {
+    case DDS_TK_STRUCT:
+    case DDS_TK_VALUE:
+    case DDS_TK_SPARSE:
+    case DDS_TK_UNION:
+    case DDS_TK_ENUM:
+      {
+        const char * const tc_name = DDS_TypeCode_name(tc, &ex);
+        if (DDS_NO_EXCEPTION_CODE != ex) {
+          throw std::runtime_error("failed to get typecode name");
+        }
+        const bool transform_names = DDS_TK_STRUCT == tc_kind;
+        const bool has_struct_members = DDS_TK_STRUCT == tc_kind ||
+          DDS_TK_VALUE == tc_kind || DDS_TK_SPARSE == tc_kind;
+        const bool has_value_members = DDS_TK_VALUE == tc_kind || DDS_TK_SPARSE == tc_kind;
+        if (transform_names && nullptr != make_name_fn_) {
+          hasher.update(make_name_fn_(tc_name));
+        } else {
+          hasher.update(tc_name);
+        }
+        if (DDS_TK_ENUM != tc_kind) {
+          hasher.update(static_cast<uint32_t>(DDS_TypeCode_extensibility_kind(tc, &ex)));
+          if (DDS_NO_EXCEPTION_CODE != ex) {
+            throw std::runtime_error("failed to get typecode extensibility");
+          }
+        }
+        if (has_value_members) {
+          hasher.update(static_cast<uint32_t>(DDS_TypeCode_type_modifier(tc, &ex)));
+          if (DDS_NO_EXCEPTION_CODE != ex) {
+            throw std::runtime_error("failed to get value type modifier");
+          }
+          const DDS_TypeCode * const base_tc = DDS_TypeCode_concrete_base_type(tc, &ex);
+          if (DDS_NO_EXCEPTION_CODE != ex) {
+            throw std::runtime_error("failed to get value type base type");
+          }
+          if (nullptr == base_tc) {
+            hasher.update(static_cast<uint32_t>(DDS_TK_NULL));
+          } else {
+            hasher.update(nested_fingerprint(base_tc, min_back_ref_depth));
+          }
+        }
+        if (DDS_TK_UNION == tc_kind) {
+          const DDS_TypeCode * const discriminator_tc = DDS_TypeCode_discriminator_type(tc, &ex);
+          if (nullptr == discriminator_tc || DDS_NO_EXCEPTION_CODE != ex) {
+            throw std::runtime_error("failed to get union discriminator type");
+          }
+          hasher.update(nested_fingerprint(discriminator_tc, min_back_ref_depth));
+          hasher.update(static_cast<uint32_t>(DDS_TypeCode_default_index(tc, &ex)));
+          if (DDS_NO_EXCEPTION_CODE != ex) {
+            throw std::runtime_error("failed to get union default index");
+          }
+        }
+        const DDS_UnsignedLong member_count = DDS_TypeCode_member_count(tc, &ex);
+        if (DDS_NO_EXCEPTION_CODE != ex) {
+          throw std::runtime_error("failed to get typecode member count");
+        }
+        hasher.update(static_cast<uint32_t>(member_count));
+        for (DDS_UnsignedLong i = 0; i < member_count; i++) {
+          const char * const member_name = DDS_TypeCode_member_name(tc, i, &ex);
+          if (DDS_NO_EXCEPTION_CODE != ex) {
+            throw std::runtime_error("failed to get member name");
+          }
+          if (transform_names && nullptr != make_member_name_fn_) {
+            hasher.update(make_member_name_fn_(member_name));
+          } else {
+            hasher.update(member_name);
+          }
+          if (DDS_TK_ENUM == tc_kind) {
+            hasher.update(static_cast<uint32_t>(DDS_TypeCode_member_ordinal(tc, i, &ex)));
+            if (DDS_NO_EXCEPTION_CODE != ex) {
+              throw std::runtime_error("failed to get member ordinal");
+            }
+            continue;
+          }
+          hasher.update(static_cast<uint32_t>(DDS_TypeCode_member_id(tc, i, &ex)));
+          if (DDS_NO_EXCEPTION_CODE != ex) {
+            throw std::runtime_error("failed to get member id");
+          }
+          hasher.update(static_cast<uint32_t>(DDS_TypeCode_is_member_pointer(tc, i, &ex)));
+          if (DDS_NO_EXCEPTION_CODE != ex) {
+            throw std::runtime_error("failed to get member pointer flag");
+          }
+          if (has_struct_members) {
+            hasher.update(static_cast<uint32_t>(DDS_TypeCode_is_member_key(tc, i, &ex)));
+            if (DDS_NO_EXCEPTION_CODE != ex) {
+              throw std::runtime_error("failed to get member key flag");
+            }
+            hasher.update(static_cast<uint32_t>(DDS_TypeCode_is_member_required(tc, i, &ex)));
+            if (DDS_NO_EXCEPTION_CODE != ex) {
+              throw std::runtime_error("failed to get member required flag");
+            }
+            hasher.update(static_cast<uint32_t>(DDS_TypeCode_member_bitfield_bits(tc, i, &ex)));
+            if (DDS_NO_EXCEPTION_CODE != ex) {
+              throw std::runtime_error("failed to get member bitfield bits");
+            }
+          }
+          if (has_value_members) {
+            hasher.update(static_cast<uint32_t>(DDS_TypeCode_member_visibility(tc, i, &ex)));
+            if (DDS_NO_EXCEPTION_CODE != ex) {
+              throw std::runtime_error("failed to get member visibility");
+            }
+          }
+          if (DDS_TK_UNION == tc_kind) {
+            const DDS_UnsignedLong label_count = DDS_TypeCode_member_label_count(tc, i, &ex);
+            if (DDS_NO_EXCEPTION_CODE != ex) {
+              throw std::runtime_error("failed to get member label count");
+            }
+            hasher.update(static_cast<uint32_t>(label_count));
+            for (DDS_UnsignedLong l = 0; l < label_count; l++) {
+              hasher.update(static_cast<uint32_t>(DDS_TypeCode_member_label(tc, i, l, &ex)));
+              if (DDS_NO_EXCEPTION_CODE != ex) {
+                throw std::runtime_error("failed to get member label");
+              }
+            }
+          }
+          const DDS_TypeCode * const member_tc = DDS_TypeCode_member_type(tc, i, &ex);
+          if (nullptr == member_tc || DDS_NO_EXCEPTION_CODE != ex) {
+            throw std::runtime_error("failed to get typecode member id");
+          }
+          hasher.update(nested_fingerprint(member_tc, min_back_ref_depth));
+        }
+        break;
+      }
+    case DDS_TK_STRING:
+    case DDS_TK_WSTRING:
+      {
+        hasher.update(static_cast<uint32_t>(DDS_TypeCode_length(tc, &ex)));
+        if (DDS_NO_EXCEPTION_CODE != ex) {
+          throw std::runtime_error("failed to get string bound");
+        }
+        break;
+      }
+    case DDS_TK_SEQUENCE:
+    case DDS_TK_ARRAY:
+    case DDS_TK_ALIAS:
+      {
+        if (DDS_TK_SEQUENCE == tc_kind) {
+          hasher.update(static_cast<uint32_t>(DDS_TypeCode_length(tc, &ex)));
+          if (DDS_NO_EXCEPTION_CODE != ex) {
+            throw std::runtime_error("failed to get sequence bound");
+          }
+        } else if (DDS_TK_ARRAY == tc_kind) {
+          const DDS_UnsignedLong dim_count = DDS_TypeCode_array_dimension_count(tc, &ex);
+          if (DDS_NO_EXCEPTION_CODE != ex) {
+            throw std::runtime_error("failed to get array dimension count");
+          }
+          hasher.update(static_cast<uint32_t>(dim_count));
+          for (DDS_UnsignedLong i = 0; i < dim_count; i++) {
+            hasher.update(static_cast<uint32_t>(DDS_TypeCode_array_dimension(tc, i, &ex)));
+            if (DDS_NO_EXCEPTION_CODE != ex) {
+              throw std::runtime_error("failed to get array dimension");
+            }
+          }
+        } else {
+          hasher.update(DDS_TypeCode_name(tc, &ex));
+          if (DDS_NO_EXCEPTION_CODE != ex) {
+            throw std::runtime_error("failed to get typecode name");
+          }
+          hasher.update(static_cast<uint32_t>(DDS_TypeCode_is_alias_pointer(tc, &ex)));
+          if (DDS_NO_EXCEPTION_CODE != ex) {
+            throw std::runtime_error("failed to get alias pointer flag");
+          }
+        }
+        const DDS_TypeCode * const content_tc = DDS_TypeCode_content_type(tc, &ex);
+        if (nullptr == content_tc || DDS_NO_EXCEPTION_CODE != ex) {
+          throw std::runtime_error("failed to get collection typecode");
+        }
+        hasher.update(nested_fingerprint(content_tc, min_back_ref_depth));
+        break;
+      }
+    default:
+      {
+        // Primitive types are fully identified by their kind.
+        break;
+      }
+  }
+}
+
+TypeCodeFingerprint
+fingerprint_typecode(const DDS_TypeCode * const tc)
+{
+  TypeCodeFingerprinter fingerprinter;
+  return fingerprinter.fingerprint(tc);
+}
+}  // namespace robotspy
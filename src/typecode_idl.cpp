@@ -0,0 +1,718 @@
+// (c) 2023 Copyright, Real-Time Innovations, Inc.  All rights reserved.
+//
+// RTI grants Licensee a license to use, modify, compile, and create derivative
+// works of the Software.  Licensee has the right to distribute object form
+// only for use with RTI products.  The Software is provided "as is", with no
+// warranty of any type, including any warranty for fitness for any purpose.
+// RTI is under no obligation to maintain or support the Software.  RTI shall
+// not be liable for any incidental or consequential damages arising out of the
+// use or inability to use the software.
+#include <algorithm>
+#include <map>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+#include "robotspy/typecode_idl.hpp"
+
+namespace robotspy
+{
+static
+DDS_TCKind
+idl_kind(const DDS_TypeCode * const tc)
+{
+  DDS_ExceptionCode_t ex = DDS_NO_EXCEPTION_CODE;
+  const DDS_TCKind kind = DDS_TypeCode_kind(tc, &ex);
+  if (DDS_NO_EXCEPTION_CODE != ex) {
+    throw std::runtime_error("failed to get typecode kind");
+  }
+  return kind;
+}
+
+static
+const char *
+idl_name(const DDS_TypeCode * const tc)
+{
+  DDS_ExceptionCode_t ex = DDS_NO_EXCEPTION_CODE;
+  const char * const name = DDS_TypeCode_name(tc, &ex);
+  if (nullptr == name || DDS_NO_EXCEPTION_CODE != ex) {
+    throw std::runtime_error("failed to get typecode name");
+  }
+  return name;
+}
+
+static
+DDS_UnsignedLong
+idl_member_count(const DDS_TypeCode * const tc)
+{
+  DDS_ExceptionCode_t ex = DDS_NO_EXCEPTION_CODE;
+  const DDS_UnsignedLong member_count = DDS_TypeCode_member_count(tc, &ex);
+  if (DDS_NO_EXCEPTION_CODE != ex) {
+    throw std::runtime_error("failed to get typecode member count");
+  }
+  return member_count;
+}
+
+static
+const char *
+idl_member_name(const DDS_TypeCode * const tc, const DDS_UnsignedLong i)
+{
+  DDS_ExceptionCode_t ex = DDS_NO_EXCEPTION_CODE;
+  const char * const member_name = DDS_TypeCode_member_name(tc, i, &ex);
+  if (nullptr == member_name || DDS_NO_EXCEPTION_CODE != ex) {
+    throw std::runtime_error("failed to get member name");
+  }
+  return member_name;
+}
+
+static
+const DDS_TypeCode *
+idl_member_type(const DDS_TypeCode * const tc, const DDS_UnsignedLong i)
+{
+  DDS_ExceptionCode_t ex = DDS_NO_EXCEPTION_CODE;
+  const DDS_TypeCode * const member_tc = DDS_TypeCode_member_type(tc, i, &ex);
+  if (nullptr == member_tc || DDS_NO_EXCEPTION_CODE != ex) {
+    throw std::runtime_error("failed to get member type");
+  }
+  return member_tc;
+}
+
+static
+const DDS_TypeCode *
+idl_content_type(const DDS_TypeCode * const tc)
+{
+  DDS_ExceptionCode_t ex = DDS_NO_EXCEPTION_CODE;
+  const DDS_TypeCode * const content_tc = DDS_TypeCode_content_type(tc, &ex);
+  if (nullptr == content_tc || DDS_NO_EXCEPTION_CODE != ex) {
+    throw std::runtime_error("failed to get collection typecode");
+  }
+  return content_tc;
+}
+
+static
+const DDS_TypeCode *
+idl_discriminator_type(const DDS_TypeCode * const tc)
+{
+  DDS_ExceptionCode_t ex = DDS_NO_EXCEPTION_CODE;
+  const DDS_TypeCode * const disc_tc = DDS_TypeCode_discriminator_type(tc, &ex);
+  if (nullptr == disc_tc || DDS_NO_EXCEPTION_CODE != ex) {
+    throw std::runtime_error("failed to get union discriminator type");
+  }
+  return disc_tc;
+}
+
+static
+bool
+idl_is_named_kind(const DDS_TCKind kind)
+{
+  switch (kind) {
+    case DDS_TK_STRUCT:
+    case DDS_TK_UNION:
+    case DDS_TK_ENUM:
+    case DDS_TK_ALIAS:
+    case DDS_TK_VALUE:
+    case DDS_TK_SPARSE:
+      return true;
+    default:
+      return false;
+  }
+}
+
+// A named type, and the named types that must be defined before it.
+struct IdlType
+{
+  const DDS_TypeCode * tc;
+  std::string name;
+  size_t module;
+  std::vector<size_t> deps;
+};
+
+// All the named types reachable from a set of types, and the order in
+// which they must be defined.
+class IdlTypeGraph
+{
+public:
+  explicit IdlTypeGraph(const std::vector<const DDS_TypeCode *> & roots)
+  {
+    std::vector<size_t> pending;
+    for (auto & tc : roots) {
+      add(tc, pending);
+    }
+    while (!pending.empty()) {
+      const size_t next = pending.back();
+      pending.pop_back();
+      std::vector<const DDS_TypeCode *> refs;
+      references(types_[next].tc, refs);
+      for (auto & ref : refs) {
+        const size_t dep = add(ref, pending);
+        if (dep != next) {
+          types_[next].deps.push_back(dep);
+        }
+      }
+    }
+    for (auto & type : types_) {
+      std::sort(type.deps.begin(), type.deps.end());
+      type.deps.erase(std::unique(type.deps.begin(), type.deps.end()), type.deps.end());
+    }
+    assign_modules();
+  }
+
+  const std::vector<IdlType> &
+  types() const
+  {
+    return types_;
+  }
+
+  const std::vector<std::string> &
+  modules() const
+  {
+    return modules_;
+  }
+
+  // Sort the types so that each type follows its dependencies. Modules are
+  // sorted first (Kahn's algorithm over the module dependency graph), and
+  // all types of a module are then emitted together. Types in modules
+  // which depend on each other are sorted individually, which requires
+  // reopening some modules.
+  std::vector<size_t>
+  sort() const
+  {
+    std::vector<size_t> pending(types_.size());
+    std::vector<std::vector<size_t>> dependents(types_.size());
+    std::vector<std::vector<size_t>> module_types(modules_.size());
+    std::vector<std::set<size_t>> module_deps(modules_.size());
+    std::vector<std::set<size_t>> module_dependents(modules_.size());
+    for (size_t i = 0; i < types_.size(); i++) {
+      pending[i] = types_[i].deps.size();
+      module_types[types_[i].module].push_back(i);
+      for (auto & dep : types_[i].deps) {
+        dependents[dep].push_back(i);
+        const size_t dep_module = types_[dep].module;
+        if (dep_module != types_[i].module) {
+          module_deps[types_[i].module].insert(dep_module);
+          module_dependents[dep_module].insert(types_[i].module);
+        }
+      }
+    }
+
+    std::vector<size_t> order;
+    order.reserve(types_.size());
+    std::vector<bool> emitted(types_.size(), false);
+
+    std::vector<size_t> module_pending(modules_.size());
+    std::set<size_t> ready_modules;
+    for (size_t m = 0; m < modules_.size(); m++) {
+      module_pending[m] = module_deps[m].size();
+      if (0 == module_pending[m]) {
+        ready_modules.insert(m);
+      }
+    }
+    std::vector<bool> module_done(modules_.size(), false);
+    while (!ready_modules.empty()) {
+      const size_t m = *ready_modules.begin();
+      ready_modules.erase(ready_modules.begin());
+      sort_types(module_types[m], pending, dependents, emitted, order);
+      module_done[m] = true;
+      for (auto & dependent : module_dependents[m]) {
+        if (0 == --module_pending[dependent]) {
+          ready_modules.insert(dependent);
+        }
+      }
+    }
+
+    std::vector<size_t> remaining;
+    for (size_t m = 0; m < modules_.size(); m++) {
+      if (!module_done[m]) {
+        remaining.insert(remaining.end(), module_types[m].begin(), module_types[m].end());
+      }
+    }
+    if (!remaining.empty()) {
+      std::sort(remaining.begin(), remaining.end());
+      sort_types(remaining, pending, dependents, emitted, order);
+    }
+    return order;
+  }
+
+private:
+  size_t
+  add(const DDS_TypeCode * const tc, std::vector<size_t> & pending)
+  {
+    std::string name = idl_name(tc);
+    auto existing = index_.find(name);
+    if (index_.end() != existing) {
+      return existing->second;
+    }
+    const size_t i = types_.size();
+    IdlType type;
+    type.tc = tc;
+    type.name = name;
+    type.module = 0;
+    types_.push_back(std::move(type));
+    index_.emplace(std::move(name), i);
+    pending.push_back(i);
+    return i;
+  }
+
+  // Find the named types directly referenced by a named type.
+  static
+  void
+  references(const DDS_TypeCode * const tc, std::vector<const DDS_TypeCode *> & refs)
+  {
+    switch (idl_kind(tc)) {
+      case DDS_TK_STRUCT:
+      case DDS_TK_UNION:
+        {
+          if (DDS_TK_UNION == idl_kind(tc)) {
+            named_reference(idl_discriminator_type(tc), refs);
+          }
+          const DDS_UnsignedLong member_count = idl_member_count(tc);
+          for (DDS_UnsignedLong i = 0; i < member_count; i++) {
+            named_reference(idl_member_type(tc, i), refs);
+          }
+          break;
+        }
+      case DDS_TK_ALIAS:
+        {
+          named_reference(idl_content_type(tc), refs);
+          break;
+        }
+      default:
+        {
+          break;
+        }
+    }
+  }
+
+  static
+  void
+  named_reference(const DDS_TypeCode * tc, std::vector<const DDS_TypeCode *> & refs)
+  {
+    DDS_TCKind kind = idl_kind(tc);
+    while (DDS_TK_SEQUENCE == kind || DDS_TK_ARRAY == kind) {
+      tc = idl_content_type(tc);
+      kind = idl_kind(tc);
+    }
+    if (idl_is_named_kind(kind)) {
+      refs.push_back(tc);
+    }
+  }
+
+  // Modules are numbered in alphabetical order, so that independent
+  // modules are emitted in a stable order.
+  void
+  assign_modules()
+  {
+    std::map<std::string, size_t> modules;
+    for (auto & type : types_) {
+      const size_t sep = type.name.rfind("::");
+      modules.emplace((std::string::npos != sep) ? type.name.substr(0, sep) : "", 0);
+    }
+    for (auto & m : modules) {
+      m.second = modules_.size();
+      modules_.push_back(m.first);
+    }
+    for (auto & type : types_) {
+      const size_t sep = type.name.rfind("::");
+      type.module = modules[(std::string::npos != sep) ? type.name.substr(0, sep) : ""];
+    }
+  }
+
+  // Append a subset of the types to the order, after their dependencies,
+  // preferring types from the same module as the last one. Cycles (which
+  // only recursive types may introduce) are broken by emitting the first
+  // remaining type. Dependents outside of the subset are left for the
+  // subset which contains them.
+  void
+  sort_types(
+    const std::vector<size_t> & subset,
+    std::vector<size_t> & pending,
+    const std::vector<std::vector<size_t>> & dependents,
+    std::vector<bool> & emitted,
+    std::vector<size_t> & order) const
+  {
+    std::vector<bool> in_subset(types_.size(), false);
+    std::set<std::pair<size_t, size_t>> ready;
+    size_t count = 0;
+    for (auto & i : subset) {
+      in_subset[i] = true;
+      if (emitted[i]) {
+        count += 1;
+      } else if (0 == pending[i]) {
+        ready.emplace(types_[i].module, i);
+      }
+    }
+    size_t next_forced = 0;
+    size_t current_module = (order.empty()) ? 0 : types_[order.back()].module;
+    while (count < subset.size()) {
+      size_t next;
+      if (!ready.empty()) {
+        auto it = ready.lower_bound(std::make_pair(current_module, static_cast<size_t>(0)));
+        if (ready.end() == it || it->first != current_module) {
+          it = ready.begin();
+        }
+        next = it->second;
+        ready.erase(it);
+      } else {
+        while (next_forced < subset.size() && emitted[subset[next_forced]]) {
+          next_forced += 1;
+        }
+        if (next_forced == subset.size()) {
+          break;
+        }
+        next = subset[next_forced];
+      }
+      if (emitted[next]) {
+        continue;
+      }
+      emitted[next] = true;
+      order.push_back(next);
+      current_module = types_[next].module;
+      count += 1;
+      for (auto & dependent : dependents[next]) {
+        if (0 == --pending[dependent] && in_subset[dependent] && !emitted[dependent]) {
+          ready.emplace(types_[dependent].module, dependent);
+        }
+      }
+    }
+  }
+
+  std::vector<IdlType> types_;
+  std::unordered_map<std::string, size_t> index_;
+  std::vector<std::string> modules_;
+};
+
+class IdlWriter
+{
+public:
+  explicit IdlWriter(std::ostream & out)
+  : out_(out)
+  {}
+
+  ~IdlWriter()
+  {
+    enter(std::vector<std::string>());
+  }
+
+  // Close and open module blocks to move into a module scope.
+  void
+  enter(const std::vector<std::string> & module)
+  {
+    size_t common = 0;
+    while (common < module_.size() && common < module.size() &&
+      module_[common] == module[common])
+    {
+      common += 1;
+    }
+    while (module_.size() > common) {
+      module_.pop_back();
+      indent() << "};" << std::endl;
+    }
+    while (module_.size() < module.size()) {
+      indent() << "module " << module[module_.size()] << " {" << std::endl;
+      module_.push_back(module[module_.size()]);
+    }
+  }
+
+  void
+  write(const IdlType & type)
+  {
+    const size_t sep = type.name.rfind("::");
+    const std::string local_name =
+      (std::string::npos != sep) ? type.name.substr(sep + 2) : type.name;
+    switch (idl_kind(type.tc)) {
+      case DDS_TK_STRUCT:
+        {
+          write_struct(type.tc, local_name);
+          break;
+        }
+      case DDS_TK_UNION:
+        {
+          write_union(type.tc, local_name);
+          break;
+        }
+      case DDS_TK_ENUM:
+        {
+          write_enum(type.tc, local_name);
+          break;
+        }
+      case DDS_TK_ALIAS:
+        {
+          indent() << "typedef " << declaration(idl_content_type(type.tc), local_name) << ";" <<
+            std::endl;
+          break;
+        }
+      default:
+        {
+          indent() << "// unsupported type: " << type.name << std::endl;
+          break;
+        }
+    }
+  }
+
+private:
+  std::ostream &
+  indent(const size_t extra = 0)
+  {
+    for (size_t i = 0; i < module_.size() + extra; i++) {
+      out_ << "  ";
+    }
+    return out_;
+  }
+
+  void
+  write_struct(const DDS_TypeCode * const tc, const std::string & local_name)
+  {
+    DDS_ExceptionCode_t ex = DDS_NO_EXCEPTION_CODE;
+    const DDS_ExtensibilityKind extensibility = DDS_TypeCode_extensibility_kind(tc, &ex);
+    if (DDS_NO_EXCEPTION_CODE != ex) {
+      throw std::runtime_error("failed to get typecode extensibility");
+    }
+    switch (extensibility) {
+      case DDS_FINAL_EXTENSIBILITY:
+        {
+          indent() << "@final" << std::endl;
+          break;
+        }
+      case DDS_MUTABLE_EXTENSIBILITY:
+        {
+          indent() << "@mutable" << std::endl;
+          break;
+        }
+      default:
+        {
+          indent() << "@appendable" << std::endl;
+          break;
+        }
+    }
+    indent() << "struct " << local_name << " {" << std::endl;
+    const DDS_UnsignedLong member_count = idl_member_count(tc);
+    for (DDS_UnsignedLong i = 0; i < member_count; i++) {
+      indent(1);
+      if (DDS_TypeCode_is_member_key(tc, i, &ex)) {
+        out_ << "@key ";
+      } else if (DDS_NO_EXCEPTION_CODE == ex && !DDS_TypeCode_is_member_required(tc, i, &ex)) {
+        out_ << "@optional ";
+      }
+      if (DDS_NO_EXCEPTION_CODE != ex) {
+        throw std::runtime_error("failed to get member flags");
+      }
+      out_ << declaration(idl_member_type(tc, i), idl_member_name(tc, i)) << ";" << std::endl;
+    }
+    indent() << "};" << std::endl;
+  }
+
+  void
+  write_enum(const DDS_TypeCode * const tc, const std::string & local_name)
+  {
+    DDS_ExceptionCode_t ex = DDS_NO_EXCEPTION_CODE;
+    indent() << "enum " << local_name << " {" << std::endl;
+    const DDS_UnsignedLong member_count = idl_member_count(tc);
+    DDS_Long next_ordinal = 0;
+    for (DDS_UnsignedLong i = 0; i < member_count; i++) {
+      const DDS_Long ordinal = DDS_TypeCode_member_ordinal(tc, i, &ex);
+      if (DDS_NO_EXCEPTION_CODE != ex) {
+        throw std::runtime_error("failed to get member ordinal");
+      }
+      indent(1);
+      if (ordinal != next_ordinal) {
+        out_ << "@value(" << ordinal << ") ";
+      }
+      out_ << idl_member_name(tc, i) << ((i + 1 < member_count) ? "," : "") << std::endl;
+      next_ordinal = ordinal + 1;
+    }
+    indent() << "};" << std::endl;
+  }
+
+  void
+  write_union(const DDS_TypeCode * const tc, const std::string & local_name)
+  {
+    DDS_ExceptionCode_t ex = DDS_NO_EXCEPTION_CODE;
+    const DDS_TypeCode * disc_tc = idl_discriminator_type(tc);
+    indent() << "union " << local_name << " switch (" << type_spec(disc_tc) << ") {" <<
+      std::endl;
+    while (DDS_TK_ALIAS == idl_kind(disc_tc)) {
+      disc_tc = idl_content_type(disc_tc);
+    }
+    const DDS_Long default_index = DDS_TypeCode_default_index(tc, &ex);
+    if (DDS_NO_EXCEPTION_CODE != ex) {
+      throw std::runtime_error("failed to get union default index");
+    }
+    const DDS_UnsignedLong member_count = idl_member_count(tc);
+    for (DDS_UnsignedLong i = 0; i < member_count; i++) {
+      if (static_cast<DDS_Long>(i) == default_index) {
+        indent(1) << "default:" << std::endl;
+      } else {
+        const DDS_UnsignedLong label_count = DDS_TypeCode_member_label_count(tc, i, &ex);
+        if (DDS_NO_EXCEPTION_CODE != ex) {
+          throw std::runtime_error("failed to get union member label count");
+        }
+        for (DDS_UnsignedLong j = 0; j < label_count; j++) {
+          const DDS_Long label = DDS_TypeCode_member_label(tc, i, j, &ex);
+          if (DDS_NO_EXCEPTION_CODE != ex) {
+            throw std::runtime_error("failed to get union member label");
+          }
+          indent(1) << "case " << union_label(disc_tc, label) << ":" << std::endl;
+        }
+      }
+      indent(2) << declaration(idl_member_type(tc, i), idl_member_name(tc, i)) << ";" <<
+        std::endl;
+    }
+    indent() << "};" << std::endl;
+  }
+
+  static
+  std::string
+  union_label(const DDS_TypeCode * const disc_tc, const DDS_Long label)
+  {
+    switch (idl_kind(disc_tc)) {
+      case DDS_TK_BOOLEAN:
+        {
+          return (label) ? "TRUE" : "FALSE";
+        }
+      case DDS_TK_ENUM:
+        {
+          // Enumerators are scoped by the module which contains the enum.
+          DDS_ExceptionCode_t ex = DDS_NO_EXCEPTION_CODE;
+          const DDS_UnsignedLong member_count = idl_member_count(disc_tc);
+          for (DDS_UnsignedLong i = 0; i < member_count; i++) {
+            if (DDS_TypeCode_member_ordinal(disc_tc, i, &ex) == label &&
+              DDS_NO_EXCEPTION_CODE == ex)
+            {
+              const std::string enum_name = idl_name(disc_tc);
+              const size_t sep = enum_name.rfind("::");
+              return "::" + ((std::string::npos != sep) ? enum_name.substr(0, sep + 2) : "") +
+                     idl_member_name(disc_tc, i);
+            }
+          }
+          throw std::runtime_error("invalid enum union label");
+        }
+      default:
+        {
+          return std::to_string(label);
+        }
+    }
+  }
+
+  // Declaration of a member (or alias) with the specified type. Array
+  // dimensions follow the declared name.
+  static
+  std::string
+  declaration(const DDS_TypeCode * tc, const std::string & name)
+  {
+    std::string dims;
+    while (DDS_TK_ARRAY == idl_kind(tc)) {
+      DDS_ExceptionCode_t ex = DDS_NO_EXCEPTION_CODE;
+      const DDS_UnsignedLong dim_count = DDS_TypeCode_array_dimension_count(tc, &ex);
+      if (DDS_NO_EXCEPTION_CODE != ex) {
+        throw std::runtime_error("failed to get array dimension count");
+      }
+      for (DDS_UnsignedLong i = 0; i < dim_count; i++) {
+        const DDS_UnsignedLong dim = DDS_TypeCode_array_dimension(tc, i, &ex);
+        if (DDS_NO_EXCEPTION_CODE != ex) {
+          throw std::runtime_error("failed to get array dimension");
+        }
+        dims += "[" + std::to_string(dim) + "]";
+      }
+      tc = idl_content_type(tc);
+    }
+    return type_spec(tc) + " " + name + dims;
+  }
+
+  static
+  std::string
+  bound_suffix(const DDS_TypeCode * const tc, const char * const sep)
+  {
+    DDS_ExceptionCode_t ex = DDS_NO_EXCEPTION_CODE;
+    const DDS_UnsignedLong len = DDS_TypeCode_length(tc, &ex);
+    if (DDS_NO_EXCEPTION_CODE != ex) {
+      throw std::runtime_error("failed to get typecode length");
+    }
+    if (0 == len || len >= static_cast<DDS_UnsignedLong>(RTIXCdrLong_MAX)) {
+      return std::string();
+    }
+    return sep + std::to_string(len);
+  }
+
+  static
+  std::string
+  type_spec(const DDS_TypeCode * const tc)
+  {
+    const DDS_TCKind kind = idl_kind(tc);
+    switch (kind) {
+      case DDS_TK_BOOLEAN: return "boolean";
+      case DDS_TK_CHAR: return "char";
+      case DDS_TK_WCHAR: return "wchar";
+      case DDS_TK_OCTET: return "octet";
+      case DDS_TK_SHORT: return "short";
+      case DDS_TK_USHORT: return "unsigned short";
+      case DDS_TK_LONG: return "long";
+      case DDS_TK_ULONG: return "unsigned long";
+      case DDS_TK_LONGLONG: return "long long";
+      case DDS_TK_ULONGLONG: return "unsigned long long";
+      case DDS_TK_FLOAT: return "float";
+      case DDS_TK_DOUBLE: return "double";
+      case DDS_TK_LONGDOUBLE: return "long double";
+      case DDS_TK_STRING:
+        {
+          const std::string bound = bound_suffix(tc, "");
+          return (bound.empty()) ? "string" : "string<" + bound + ">";
+        }
+      case DDS_TK_WSTRING:
+        {
+          const std::string bound = bound_suffix(tc, "");
+          return (bound.empty()) ? "wstring" : "wstring<" + bound + ">";
+        }
+      case DDS_TK_SEQUENCE:
+        {
+          return "sequence<" + type_spec(idl_content_type(tc)) + bound_suffix(tc, ", ") + ">";
+        }
+      default:
+        {
+          if (idl_is_named_kind(kind)) {
+            return std::string("::") + idl_name(tc);
+          }
+          throw std::runtime_error("unsupported typecode kind");
+        }
+    }
+  }
+
+  std::ostream & out_;
+  std::vector<std::string> module_;
+};
+
+static
+std::vector<std::string>
+split_module(const std::string & module)
+{
+  std::vector<std::string> result;
+  size_t start = 0;
+  while (start < module.size()) {
+    size_t sep = module.find("::", start);
+    if (std::string::npos == sep) {
+      sep = module.size();
+    }
+    result.push_back(module.substr(start, sep - start));
+    start = sep + 2;
+  }
+  return result;
+}
+
+void
+write_idl(std::ostream & out, const std::vector<const DDS_TypeCode *> & types)
+{
+  const IdlTypeGraph graph(types);
+  std::vector<std::vector<std::string>> modules;
+  modules.reserve(graph.modules().size());
+  for (auto & module : graph.modules()) {
+    modules.push_back(split_module(module));
+  }
+  IdlWriter writer(out);
+  for (auto & i : graph.sort()) {
+    const IdlType & type = graph.types()[i];
+    writer.enter(modules[type.module]);
+    writer.write(type);
+  }
+}
+}  // namespace robotspy
@@ -0,0 +1,696 @@
+// (c) 2023 Copyright, Real-Time Innovations, Inc.  All rights reserved.
+//
+// RTI grants Licensee a license to use, modify, compile, and create derivative
+// works of the Software.  Licensee has the right to distribute object form
+// only for use with RTI products.  The Software is provided "as is", with no
+// warranty of any type, including any warranty for fitness for any purpose.
+// RTI is under no obligation to maintain or support the Software.  RTI shall
+// not be liable for any incidental or consequential damages arising out of the
+// use or inability to use the software.
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <unordered_map>
+
+#include "rcpputils/scope_exit.hpp"
+
+#include "robotspy/typecode_store.hpp"
+
+namespace robotspy
+{
+// File layout (all integers in native byte order):
+//   header:  magic[8], byte_order, version, flags, record_count, type_count,
+//            topic_count (uint32), records_offset, types_offset,
+//            topics_offset (uint64)
+//   records: uint64 offset of each record, followed by the records
+//   types:   (name, record, fp.hi, fp.lo, version) for each named type
+//   topics:  (topic name, type name) for each topic
+// Strings are stored as a uint32 length, followed by their characters and
+// a NUL terminator, so that they can be passed to the DDS API in place.
+static const char STORE_MAGIC[8] = {'R', 'S', 'P', 'Y', 'T', 'C', 'S', '\0'};
+static const uint32_t STORE_BYTE_ORDER = 0x01020304;
+static const size_t STORE_HEADER_SIZE = sizeof(STORE_MAGIC) + 6 * 4 + 3 * 8;
+
+class StoreWriter
+{
+public:
+  void
+  put(const void * const data, const size_t len)
+  {
+    buffer_.append(static_cast<const char *>(data), len);
+  }
+
+  void
+  put(const uint32_t value)
+  {
+    put(&value, sizeof(value));
+  }
+
+  void
+  put(const uint64_t value)
+  {
+    put(&value, sizeof(value));
+  }
+
+  void
+  put(const std::string_view & str)
+  {
+    if (str.length() > UINT32_MAX) {
+      throw std::runtime_error("string too long to store");
+    }
+    put(static_cast<uint32_t>(str.length()));
+    buffer_.append(str.data(), str.length());
+    buffer_.push_back('\0');
+  }
+
+  const std::string &
+  buffer() const
+  {
+    return buffer_;
+  }
+
+private:
+  std::string buffer_;
+};
+
+class StoreReader
+{
+public:
+  StoreReader(const char * const data, const size_t size, const uint64_t offset)
+  : data_(data),
+    size_(size),
+    pos_(offset)
+  {
+    if (offset > size) {
+      throw std::runtime_error("invalid offset in typecode store");
+    }
+  }
+
+  uint32_t
+  u32()
+  {
+    uint32_t value;
+    read(&value, sizeof(value));
+    return value;
+  }
+
+  uint64_t
+  u64()
+  {
+    uint64_t value;
+    read(&value, sizeof(value));
+    return value;
+  }
+
+  // Returns a NUL-terminated string
+  std::string_view
+  str()
+  {
+    const uint32_t len = u32();
+    if (size_ - pos_ < static_cast<uint64_t>(len) + 1 || data_[pos_ + len] != '\0') {
+      throw std::runtime_error("truncated string in typecode store");
+    }
+    std::string_view result(data_ + pos_, len);
+    pos_ += len + 1;
+    return result;
+  }
+
+private:
+  void
+  read(void * const value, const size_t len)
+  {
+    if (size_ - pos_ < len) {
+      throw std::runtime_error("truncated typecode store");
+    }
+    memcpy(value, data_ + pos_, len);
+    pos_ += len;
+  }
+
+  const char * data_;
+  size_t size_;
+  uint64_t pos_;
+};
+
+// Serializes every distinct typecode in the graph of a type once, after
+// all the typecodes that it references.
+class StoreRecordWriter
+{
+public:
+  uint32_t
+  write(const DDS_TypeCode * const tc)
+  {
+    auto written = ids_.find(tc);
+    if (ids_.end() != written) {
+      return written->second;
+    }
+    DDS_ExceptionCode_t ex = DDS_NO_EXCEPTION_CODE;
+    const DDS_TCKind tc_kind = DDS_TypeCode_kind(tc, &ex);
+    if (DDS_NO_EXCEPTION_CODE != ex) {
+      throw std::runtime_error("failed to get typecode kind");
+    }
+    StoreWriter record;
+    record.put(static_cast<uint32_t>(tc_kind));
+    switch (tc_kind) {
+      case DDS_TK_STRUCT:
+        {
+          record.put(name(tc));
+          record.put(static_cast<uint32_t>(DDS_TypeCode_extensibility_kind(tc, &ex)));
+          if (DDS_NO_EXCEPTION_CODE != ex) {
+            throw std::runtime_error("failed to get typecode extensibility");
+          }
+          const DDS_UnsignedLong member_count = DDS_TypeCode_member_count(tc, &ex);
+          if (DDS_NO_EXCEPTION_CODE != ex) {
+            throw std::runtime_error("failed to get typecode member count");
+          }
+          record.put(static_cast<uint32_t>(member_count));
+          for (DDS_UnsignedLong i = 0; i < member_count; i++) {
+            const char * const member_name = DDS_TypeCode_member_name(tc, i, &ex);
+            if (nullptr == member_name || DDS_NO_EXCEPTION_CODE != ex) {
+              throw std::runtime_error("failed to get member name");
+            }
+            const DDS_TypeCode * const member_tc = DDS_TypeCode_member_type(tc, i, &ex);
+            if (nullptr == member_tc || DDS_NO_EXCEPTION_CODE != ex) {
+              throw std::runtime_error("failed to get typecode member id");
+            }
+            const uint32_t is_key = DDS_TypeCode_is_member_key(tc, i, &ex) ? 1 : 0;
+            if (DDS_NO_EXCEPTION_CODE != ex) {
+              throw std::runtime_error("failed to get member key flag");
+            }
+            const uint32_t is_optional = DDS_TypeCode_is_member_required(tc, i, &ex) ? 0 : 1;
+            if (DDS_NO_EXCEPTION_CODE != ex) {
+              throw std::runtime_error("failed to get member required flag");
+            }
+            const uint32_t is_pointer = DDS_TypeCode_is_member_pointer(tc, i, &ex) ? 1 : 0;
+            if (DDS_NO_EXCEPTION_CODE != ex) {
+              throw std::runtime_error("failed to get member pointer flag");
+            }
+            const DDS_Short bits = DDS_TypeCode_member_bitfield_bits(tc, i, &ex);
+            if (DDS_NO_EXCEPTION_CODE != ex) {
+              throw std::runtime_error("failed to get member bitfield bits");
+            }
+            const DDS_Long id = DDS_TypeCode_member_id(tc, i, &ex);
+            if (DDS_NO_EXCEPTION_CODE != ex) {
+              throw std::runtime_error("failed to get member id");
+            }
+            record.put(std::string_view(member_name));
+            record.put(write(member_tc));
+            record.put(is_key | (is_optional << 1) | (is_pointer << 2));
+            record.put(static_cast<uint32_t>(static_cast<int32_t>(bits)));
+            record.put(static_cast<uint32_t>(id));
+          }
+          break;
+        }
+      case DDS_TK_ENUM:
+        {
+          record.put(name(tc));
+          const DDS_UnsignedLong member_count = DDS_TypeCode_member_count(tc, &ex);
+          if (DDS_NO_EXCEPTION_CODE != ex) {
+            throw std::runtime_error("failed to get typecode member count");
+          }
+          record.put(static_cast<uint32_t>(member_count));
+          for (DDS_UnsignedLong i = 0; i < member_count; i++) {
+            const char * const member_name = DDS_TypeCode_member_name(tc, i, &ex);
+            if (nullptr == member_name || DDS_NO_EXCEPTION_CODE != ex) {
+              throw std::runtime_error("failed to get member name");
+            }
+            const DDS_Long ordinal = DDS_TypeCode_member_ordinal(tc, i, &ex);
+            if (DDS_NO_EXCEPTION_CODE != ex) {
+              throw std::runtime_error("failed to get member ordinal");
+            }
+            record.put(std::string_view(member_name));
+            record.put(static_cast<uint32_t>(ordinal));
+          }
+          break;
+        }
+      case DDS_TK_ALIAS:
+        {
+          record.put(name(tc));
+          record.put(static_cast<uint32_t>(DDS_TypeCode_is_alias_pointer(tc, &ex) ? 1 : 0));
+          if (DDS_NO_EXCEPTION_CODE != ex) {
+            throw std::runtime_error("failed to get alias pointer flag");
+          }
+          record.put(write(content_type(tc)));
+          break;
+        }
+      case DDS_TK_STRING:
+      case DDS_TK_WSTRING:
+        {
+          record.put(static_cast<uint32_t>(length(tc)));
+          break;
+        }
+      case DDS_TK_SEQUENCE:
+        {
+          record.put(static_cast<uint32_t>(length(tc)));
+          record.put(write(content_type(tc)));
+          break;
+        }
+      case DDS_TK_ARRAY:
+        {
+          const DDS_UnsignedLong dim_count = DDS_TypeCode_array_dimension_count(tc, &ex);
+          if (DDS_NO_EXCEPTION_CODE != ex) {
+            throw std::runtime_error("failed to get array dimension count");
+          }
+          record.put(static_cast<uint32_t>(dim_count));
+          for (DDS_UnsignedLong i = 0; i < dim_count; i++) {
+            record.put(static_cast<uint32_t>(DDS_TypeCode_array_dimension(tc, i, &ex)));
+            if (DDS_NO_EXCEPTION_CODE != ex) {
+              throw std::runtime_error("failed to get array dimension");
+            }
+          }
+          record.put(write(content_type(tc)));
+          break;
+        }
+      case DDS_TK_UNION:
+      case DDS_TK_VALUE:
+      case DDS_TK_SPARSE:
+        {
+          throw std::runtime_error("unsupported typecode kind");
+        }
+      default:
+        {
+          // Primitive types are fully identified by their kind.
+          break;
+        }
+    }
+    const uint32_t id = static_cast<uint32_t>(offsets_.size());
+    offsets_.push_back(records_.size());
+    records_.append(record.buffer());
+    ids_.emplace(tc, id);
+    return id;
+  }
+
+  const std::vector<uint64_t> &
+  offsets() const
+  {
+    return offsets_;
+  }
+
+  const std::string &
+  records() const
+  {
+    return records_;
+  }
+
+private:
+  static
+  std::string_view
+  name(const DDS_TypeCode * const tc)
+  {
+    DDS_ExceptionCode_t ex = DDS_NO_EXCEPTION_CODE;
+    const char * const tc_name = DDS_TypeCode_name(tc, &ex);
+    if (nullptr == tc_name || DDS_NO_EXCEPTION_CODE != ex) {
+      throw std::runtime_error("failed to get typecode name");
+    }
+    return tc_name;
+  }
+
+  static
+  DDS_UnsignedLong
+  length(const DDS_TypeCode * const tc)
+  {
+    DDS_ExceptionCode_t ex = DDS_NO_EXCEPTION_CODE;
+    const DDS_UnsignedLong len = DDS_TypeCode_length(tc, &ex);
+    if (DDS_NO_EXCEPTION_CODE != ex) {
+      throw std::runtime_error("failed to get typecode length");
+    }
+    return len;
+  }
+
+  static
+  const DDS_TypeCode *
+  content_type(const DDS_TypeCode * const tc)
+  {
+    DDS_ExceptionCode_t ex = DDS_NO_EXCEPTION_CODE;
+    const DDS_TypeCode * const content_tc = DDS_TypeCode_content_type(tc, &ex);
+    if (nullptr == content_tc || DDS_NO_EXCEPTION_CODE != ex) {
+      throw std::runtime_error("failed to get collection typecode");
+    }
+    return content_tc;
+  }
+
+  std::unordered_map<const DDS_TypeCode *, uint32_t> ids_;
+  std::vector<uint64_t> offsets_;
+  std::string records_;
+};
+
+void
+TypeCodeStore::save(
+  const std::string & path,
+  const uint32_t flags,
+  const std::vector<TypeCodeStoreEntry> & types,
+  const std::vector<std::pair<std::string, std::string>> & topics,
+  std::vector<std::string> * const skipped)
+{
+  StoreRecordWriter records;
+  StoreWriter types_section;
+  uint32_t type_count = 0;
+  for (const auto & entry : types) {
+    uint32_t record = 0;
+    try {
+      record = records.write(entry.tc);
+    } catch (std::exception & e) {
+      (void)e;
+      if (nullptr != skipped) {
+        skipped->push_back(entry.name);
+      }
+      continue;
+    }
+    types_section.put(entry.name);
+    types_section.put(record);
+    types_section.put(entry.fp.hi);
+    types_section.put(entry.fp.lo);
+    types_section.put(entry.version);
+    type_count += 1;
+  }
+  StoreWriter topics_section;
+  for (const auto & topic : topics) {
+    topics_section.put(topic.first);
+    topics_section.put(topic.second);
+  }
+
+  const uint64_t records_offset = STORE_HEADER_SIZE;
+  const uint64_t records_size =
+    records.offsets().size() * sizeof(uint64_t) + records.records().size();
+  const uint64_t types_offset = records_offset + records_size;
+  const uint64_t topics_offset = types_offset + types_section.buffer().size();
+  StoreWriter header;
+  header.put(STORE_MAGIC, sizeof(STORE_MAGIC));
+  header.put(STORE_BYTE_ORDER);
+  header.put(FORMAT_VERSION);
+  header.put(flags);
+  header.put(static_cast<uint32_t>(records.offsets().size()));
+  header.put(type_count);
+  header.put(static_cast<uint32_t>(topics.size()));
+  header.put(records_offset);
+  header.put(types_offset);
+  header.put(topics_offset);
+  StoreWriter offsets;
+  const uint64_t records_data_offset =
+    records_offset + records.offsets().size() * sizeof(uint64_t);
+  for (const auto & offset : records.offsets()) {
+    offsets.put(records_data_offset + offset);
+  }
+
+  // Write to a temporary file first, so that a concurrent (or failed) run
+  // never sees a partial file.
+  const std::string tmp_path = path + ".tmp";
+  {
+    std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+    if (!out) {
+      throw std::runtime_error("failed to open file: " + tmp_path);
+    }
+    out.write(header.buffer().data(), header.buffer().size());
+    out.write(offsets.buffer().data(), offsets.buffer().size());
+    out.write(records.records().data(), records.records().size());
+    out.write(types_section.buffer().data(), types_section.buffer().size());
+    out.write(topics_section.buffer().data(), topics_section.buffer().size());
+    if (!out) {
+      throw std::runtime_error("failed to write file: " + tmp_path);
+    }
+  }
+  if (0 != std::rename(tmp_path.c_str(), path.c_str())) {
+    std::remove(tmp_path.c_str());
+    throw std::runtime_error("failed to replace file: " + path);
+  }
+}
+
+TypeCodeStore::TypeCodeStore(const std::string & path)
+: file_(path)
+{
+  const char * const data = file_.data();
+  const size_t size = file_.size();
+  if (size < STORE_HEADER_SIZE || 0 != memcmp(data, STORE_MAGIC, sizeof(STORE_MAGIC))) {
+    throw std::runtime_error("not a typecode store: " + path);
+  }
+  StoreReader header(data, size, sizeof(STORE_MAGIC));
+  if (header.u32() != STORE_BYTE_ORDER) {
+    throw std::runtime_error("typecode store has a different byte order: " + path);
+  }
+  if (header.u32() != FORMAT_VERSION) {
+    throw std::runtime_error("unsupported typecode store version: " + path);
+  }
+  flags_ = header.u32();
+  const uint32_t record_count = header.u32();
+  const uint32_t type_count = header.u32();
+  const uint32_t topic_count = header.u32();
+  const uint64_t records_offset = header.u64();
+  const uint64_t types_offset = header.u64();
+  const uint64_t topics_offset = header.u64();
+
+  StoreReader records(data, size, records_offset);
+  record_offsets_.reserve(record_count);
+  for (uint32_t i = 0; i < record_count; i++) {
+    const uint64_t offset = records.u64();
+    if (offset >= size) {
+      throw std::runtime_error("invalid record offset in typecode store: " + path);
+    }
+    record_offsets_.push_back(offset);
+  }
+  record_names_.resize(record_count);
+  materialized_.resize(record_count, nullptr);
+
+  StoreReader types(data, size, types_offset);
+  types_.reserve(type_count);
+  for (uint32_t i = 0; i < type_count; i++) {
+    const std::string_view name = types.str();
+    StoredType stored;
+    stored.record = types.u32();
+    stored.fp.hi = types.u64();
+    stored.fp.lo = types.u64();
+    stored.version = types.str();
+    if (stored.record >= record_count) {
+      throw std::runtime_error("invalid type record in typecode store: " + path);
+    }
+    types_.emplace(name, stored);
+    if (record_names_[stored.record].empty()) {
+      record_names_[stored.record] = name;
+    }
+  }
+
+  StoreReader topics(data, size, topics_offset);
+  topics_.reserve(topic_count);
+  for (uint32_t i = 0; i < topic_count; i++) {
+    const std::string_view topic_name = topics.str();
+    const std::string_view type_name = topics.str();
+    topics_.emplace(topic_name, type_name);
+  }
+}
+
+std::vector<std::string_view>
+TypeCodeStore::names() const
+{
+  std::vector<std::string_view> result;
+  result.reserve(types_.size());
+  types_.for_each(
+    [&result](const std::string_view & name, const StoredType &) {
+      result.push_back(name);
+    });
+  return result;
+}
+
+const TypeCodeFingerprint *
+TypeCodeStore::fingerprint(const std::string_view & name) const
+{
+  const StoredType * const stored = types_.find(name);
+  return (nullptr != stored) ? &stored->fp : nullptr;
+}
+
+std::string_view
+TypeCodeStore::version(const std::string_view & name) const
+{
+  const StoredType * const stored = types_.find(name);
+  return (nullptr != stored) ? stored->version : std::string_view();
+}
+
+std::string_view
+TypeCodeStore::topic_type(const std::string_view & topic_name) const
+{
+  const std::string_view * const type_name = topics_.find(topic_name);
+  return (nullptr != type_name) ? *type_name : std::string_view();
+}
+
+bool
+TypeCodeStore::load(
+  const std::string_view & name,
+  DDS_TypeCodeFactory * const tc_factory,
+  TypeCodeArena & arena,
+  std::vector<TypeCodeStoreEntry> & loaded)
+{
+  std::lock_guard<std::mutex> lock(load_mutex_);
+  const StoredType * const stored = types_.find(name);
+  if (nullptr == stored) {
+    return false;
+  }
+  const size_t loaded_before = loaded.size();
+  DDS_TypeCode * const tc = materialize(stored->record, tc_factory, arena, loaded);
+  if (loaded.size() == loaded_before || loaded.back().tc != tc || loaded.back().name != name) {
+    TypeCodeStoreEntry entry;
+    entry.name = name;
+    entry.tc = tc;
+    entry.fp = stored->fp;
+    entry.version = stored->version;
+    loaded.push_back(std::move(entry));
+  }
+  return true;
+}
+
+DDS_TypeCode *
+TypeCodeStore::materialize(
+  const uint32_t record,
+  DDS_TypeCodeFactory * const tc_factory,
+  TypeCodeArena & arena,
+  std::vector<TypeCodeStoreEntry> & loaded)
+{
+  if (nullptr != materialized_[record]) {
+    return materialized_[record];
+  }
+  // Records only reference records stored before them, so the graph can't
+  // contain cycles, even if the file is corrupted.
+  const auto nested =
+    [this, record, tc_factory, &arena, &loaded](const uint32_t nested_record) {
+      if (nested_record >= record) {
+        throw std::runtime_error("invalid record reference in typecode store");
+      }
+      return materialize(nested_record, tc_factory, arena, loaded);
+    };
+  StoreReader reader(file_.data(), file_.size(), record_offsets_[record]);
+  const DDS_TCKind tc_kind = static_cast<DDS_TCKind>(reader.u32());
+  DDS_ExceptionCode_t ex = DDS_NO_EXCEPTION_CODE;
+  DDS_TypeCode * tc = nullptr;
+  bool owned = true;
+  switch (tc_kind) {
+    case DDS_TK_STRUCT:
+      {
+        const std::string_view tc_name = reader.str();
+        const DDS_ExtensibilityKind extensibility =
+          static_cast<DDS_ExtensibilityKind>(reader.u32());
+        const uint32_t member_count = reader.u32();
+        struct DDS_StructMemberSeq members = DDS_SEQUENCE_INITIALIZER;
+        struct DDS_StructMemberSeq * const members_ptr = &members;
+        auto scope_exit_members =
+          rcpputils::make_scope_exit(
+          [members_ptr]() {
+            DDS_StructMemberSeq_finalize(members_ptr);
+          });
+        if (!DDS_StructMemberSeq_ensure_length(&members, member_count, member_count)) {
+          throw std::runtime_error("failed to ensure sequence length");
+        }
+        for (uint32_t i = 0; i < member_count; i++) {
+          DDS_StructMember * const member = DDS_StructMemberSeq_get_reference(&members, i);
+          // Names are copied by the factory, so they can be read in place
+          member->name = const_cast<char *>(reader.str().data());
+          member->type = nested(reader.u32());
+          const uint32_t member_flags = reader.u32();
+          member->is_key = (0 != (member_flags & 0x1)) ? DDS_BOOLEAN_TRUE : DDS_BOOLEAN_FALSE;
+          member->is_optional = (0 != (member_flags & 0x2)) ? DDS_BOOLEAN_TRUE : DDS_BOOLEAN_FALSE;
+          member->is_pointer = (0 != (member_flags & 0x4)) ? DDS_BOOLEAN_TRUE : DDS_BOOLEAN_FALSE;
+          member->bits = static_cast<DDS_Short>(static_cast<int32_t>(reader.u32()));
+          member->id = static_cast<DDS_Long>(reader.u32());
+        }
+        tc = DDS_TypeCodeFactory_create_struct_tc_ex(
+          tc_factory, tc_name.data(), extensibility, &members, &ex);
+        break;
+      }
+    case DDS_TK_ENUM:
+      {
+        const std::string_view tc_name = reader.str();
+        const uint32_t member_count = reader.u32();
+        struct DDS_EnumMemberSeq members = DDS_SEQUENCE_INITIALIZER;
+        struct DDS_EnumMemberSeq * const members_ptr = &members;
+        auto scope_exit_members =
+          rcpputils::make_scope_exit(
+          [members_ptr]() {
+            DDS_EnumMemberSeq_finalize(members_ptr);
+          });
+        if (!DDS_EnumMemberSeq_ensure_length(&members, member_count, member_count)) {
+          throw std::runtime_error("failed to ensure sequence length");
+        }
+        for (uint32_t i = 0; i < member_count; i++) {
+          DDS_EnumMember * const member = DDS_EnumMemberSeq_get_reference(&members, i);
+          member->name = const_cast<char *>(reader.str().data());
+          member->ordinal = static_cast<DDS_Long>(reader.u32());
+        }
+        tc = DDS_TypeCodeFactory_create_enum_tc(tc_factory, tc_name.data(), &members, &ex);
+        break;
+      }
+    case DDS_TK_ALIAS:
+      {
+        const std::string_view tc_name = reader.str();
+        const DDS_Boolean is_pointer = (0 != reader.u32()) ? DDS_BOOLEAN_TRUE : DDS_BOOLEAN_FALSE;
+        const DDS_TypeCode * const content_tc = nested(reader.u32());
+        tc = DDS_TypeCodeFactory_create_alias_tc(
+          tc_factory, tc_name.data(), content_tc, is_pointer, &ex);
+        break;
+      }
+    case DDS_TK_STRING:
+      {
+        tc = DDS_TypeCodeFactory_create_string_tc(tc_factory, reader.u32(), &ex);
+        break;
+      }
+    case DDS_TK_WSTRING:
+      {
+        tc = DDS_TypeCodeFactory_create_wstring_tc(tc_factory, reader.u32(), &ex);
+        break;
+      }
+    case DDS_TK_SEQUENCE:
+      {
+        const DDS_UnsignedLong bound = reader.u32();
+        const DDS_TypeCode * const content_tc = nested(reader.u32());
+        tc = DDS_TypeCodeFactory_create_sequence_tc(tc_factory, bound, content_tc, &ex);
+        break;
+      }
+    case DDS_TK_ARRAY:
+      {
+        const uint32_t dim_count = reader.u32();
+        struct DDS_UnsignedLongSeq dimensions = DDS_SEQUENCE_INITIALIZER;
+        struct DDS_UnsignedLongSeq * const dimensions_ptr = &dimensions;
+        auto scope_exit_dimensions =
+          rcpputils::make_scope_exit(
+          [dimensions_ptr]() {
+            DDS_UnsignedLongSeq_finalize(dimensions_ptr);
+          });
+        if (!DDS_UnsignedLongSeq_ensure_length(&dimensions, dim_count, dim_count)) {
+          throw std::runtime_error("failed to ensure sequence length");
+        }
+        for (uint32_t i = 0; i < dim_count; i++) {
+          *DDS_UnsignedLongSeq_get_reference(&dimensions, i) = reader.u32();
+        }
+        const DDS_TypeCode * const content_tc = nested(reader.u32());
+        tc = DDS_TypeCodeFactory_create_array_tc(tc_factory, &dimensions, content_tc, &ex);
+        break;
+      }
+    case DDS_TK_UNION:
+    case DDS_TK_VALUE:
+    case DDS_TK_SPARSE:
+      {
+        throw std::runtime_error("unsupported typecode kind in typecode store");
+      }
+    default:
+      {
+        // Primitive typecodes are singletons owned by the factory
+        tc = const_cast<DDS_TypeCode *>(DDS_TypeCodeFactory_get_primitive_tc(tc_factory, tc_kind));
+        owned = false;
+        break;
+      }
+  }
+  if (nullptr == tc || DDS_NO_EXCEPTION_CODE != ex) {
+    throw std::runtime_error("failed to create typecode from typecode store");
+  }
+  if (owned) {
+    arena.adopt(tc);
+  }
+  materialized_[record] = tc;
+  const std::string_view & record_name = record_names_[record];
+  if (!record_name.empty()) {
+    TypeCodeStoreEntry entry;
+    entry.name = record_name;
+    entry.tc = tc;
+    const StoredType * const stored = types_.find(record_name);
+    entry.fp = stored->fp;
+    entry.version = stored->version;
+    loaded.push_back(std::move(entry));
+  }
+  return tc;
+}
+}  // namespace robotspy
@@ -7,7 +7,9 @@
 // RTI is under no obligation to maintain or support the Software.  RTI shall
 // not be liable for any incidental or consequential damages arising out of the
 // use or inability to use the software.
+#include <charconv>
 #include <condition_variable>
+#include <cstring>
 #include <iostream>
 #include <sstream>
 
@@ -50,6 +52,12 @@ help_menu(const std::string & prog)
     << "    Repeat to read from multiple files." << endl
     << "  -f, --filter" << endl
     << "      Only consider types whose name matches the provided regular expression." << endl
+    << "  -F, --raw-filter" << endl
+    << "      Only consider types whose DDS type name (before demangling) matches the" << endl
+    << "      provided regular expression." << endl
+    << "  --filter-at-source" << endl
+    << "      Apply the --raw-filter expression as soon as endpoints are discovered, so" << endl
+    << "      that filtered-out types are never queued for processing." << endl
     << endl
     << "Output Options:" << endl
     << "  -m, --mangle" << endl
@@ -84,6 +92,59 @@ help_menu(const std::string & prog)
     << "      \"extended\" mode relies on DDS sample metadata, while the \"basic\" mode " << endl
     << "      uses an inline header that is automatically added to the payload of every" << endl
     << "      request/reply message." << endl
+    << "  --waitset-threads N" << endl
+    << "      Number of threads used to process DDS discovery information (default: 1)." << endl
+    << "  --waitset-per-domain" << endl
+    << "      Process the discovery information of each joined domain with a dedicated" << endl
+    << "      pool of --waitset-threads threads." << endl
+    << "  --no-discovery-dedup" << endl
+    << "      Process every endpoint announcement, even if an endpoint with the same" << endl
+    << "      topic and type was already detected." << endl
+    << "  --queue-size N" << endl
+    << "      Maximum number of input records waiting to be processed (default: 65536)." << endl
+    << "      The value is rounded up to the next power of two." << endl
+    << "  --queue-overflow (block|coalesce|drop)" << endl
+    << "      What to do with new input records when the queue is full:" << endl
+    << "      wait for the queue to drain (block, the default), drop them if a record" << endl
+    << "      for the same type and topic is already queued (coalesce), or drop them" << endl
+    << "      (drop). Records are coalesced by type and topic, rather than only by" << endl
+    << "      type, so that no topic is lost, and only records queued while the queue" << endl
+    << "      is at least half full are coalesced." << endl
+    << "  --workers N" << endl
+    << "      Number of threads processing input records (default: 1)." << endl
+    << "  --ordered-output" << endl
+    << "      Emit output in the order in which input was received, even with" << endl
+    << "      multiple --workers." << endl
+    << "  --input-batch-size N" << endl
+    << "      Maximum number of input records processed per dequeue operation (default: 64)." << endl
+    << "  --paranoid-type-checks" << endl
+    << "      Always perform a deep comparison of ROS types asserted more than once," << endl
+    << "      instead of trusting matching structural fingerprints. Other DDS types" << endl
+    << "      are always compared." << endl
+    << "  --preload" << endl
+    << "      Load all ROS types installed in the ament index into the cache on" << endl
+    << "      background threads, while input is being processed." << endl
+    << "  --preload-threads N" << endl
+    << "      Number of threads used by --preload (default: 2)." << endl
+    << "  --negative-cache-ttl SECONDS" << endl
+    << "      How long to remember that the type support of a ROS type could not be" << endl
+    << "      found, before looking for it again (default: 60)." << endl
+    << "  --catalog FILE" << endl
+    << "      Look up ROS types in a catalog generated with --build-catalog, before" << endl
+    << "      loading their type support libraries." << endl
+    << "  --build-catalog FILE" << endl
+    << "      Generate a catalog of all the ROS types installed in the ament index," << endl
+    << "      then exit." << endl
+    << "  --check-core-typecodes" << endl
+    << "      Check that the typecodes of core ROS types compiled into the library" << endl
+    << "      match the ones converted from their type support, then exit." << endl
+    << "  --idl-file FILE" << endl
+    << "      Write the IDL of all detected types to FILE on exit (types loaded" << endl
+    << "      by --preload are only included if they were detected)." << endl
+    << "  --cache-file FILE" << endl
+    << "      Load previously detected types from FILE when they are first needed," << endl
+    << "      and save all detected types to it on exit (including types loaded" << endl
+    << "      by --preload)." << endl
     << endl;
 }
 
@@ -118,6 +179,29 @@ void unique_elements(std::vector<T> & vec)
   }
 }
 
+// Upper bounds for the numeric arguments parsed with parse_count()
+static const size_t MAX_THREADS = 1024;
+static const size_t MAX_QUEUE_SIZE = size_t(1) << 24;
+static const size_t MAX_BATCH_SIZE = size_t(1) << 20;
+static const size_t MAX_TTL_SECONDS = 7 * 24 * 3600;
+
+// Parse a non-negative decimal number no greater than max_value.
+// Unlike istringstream, from_chars() rejects a leading '-' for unsigned types
+// instead of silently wrapping the value around.
+static
+bool
+parse_count(const char * const arg, size_t & value, const size_t max_value)
+{
+  const char * const end = arg + strlen(arg);
+  size_t parsed = 0;
+  const auto res = std::from_chars(arg, end, parsed);
+  if (res.ec != std::errc() || res.ptr != end || parsed > max_value) {
+    return false;
+  }
+  value = parsed;
+  return true;
+}
+
 int
 parse_args(
   const int argc,
@@ -126,8 +210,11 @@ parse_args(
   DefaultLoggerOptions & log_options,
   DDSInputEmitterOptions & input_options,
   BaseOutputEmitterOptions & output_options,
-  BaseTypeMonitorOptions & options)
+  BaseTypeMonitorOptions & options,
+  std::string & build_catalog,
+  bool & check_core_typecodes)
 {
+  bool filter_at_source = false;
   for (int i = 1; i < argc; i++) {
     std::string arg = argv[i];
     if (arg == "-h" || arg == "--help") {
@@ -228,6 +315,131 @@ parse_args(
         return 1;
       }
       i += 1;
+    } else if (arg == "--waitset-threads") {
+      if (i == argc - 1) {
+        invalid_args(argv[0], "missing number of threads.");
+        return 1;
+      }
+      size_t waitset_threads = 0;
+      if (!parse_count(argv[i + 1], waitset_threads, MAX_THREADS) ||
+        waitset_threads == 0)
+      {
+        invalid_args(argv[0], "invalid number of threads.");
+        return 1;
+      }
+      input_options.waitset_threads = static_cast<uint32_t>(waitset_threads);
+      i += 1;
+    } else if (arg == "--waitset-per-domain") {
+      input_options.waitset_per_participant = true;
+    } else if (arg == "--filter-at-source") {
+      filter_at_source = true;
+    } else if (arg == "--no-discovery-dedup") {
+      input_options.discovery_dedup = false;
+    } else if (arg == "--queue-size") {
+      if (i == argc - 1) {
+        invalid_args(argv[0], "missing queue size.");
+        return 1;
+      }
+      if (!parse_count(argv[i + 1], input_options.queue_capacity, MAX_QUEUE_SIZE) ||
+        input_options.queue_capacity < 2)
+      {
+        invalid_args(argv[0], "invalid queue size.");
+        return 1;
+      }
+      i += 1;
+    } else if (arg == "--queue-overflow") {
+      if (i == argc - 1) {
+        invalid_args(argv[0], "missing overflow policy.");
+        return 1;
+      }
+      try {
+        input_options.overflow_policy =
+          input_overflow_policy_from_string(argv[i + 1]);
+      } catch (std::exception & e) {
+        invalid_args(argv[0], "failed to parse overflow policy.");
+        return 1;
+      }
+      i += 1;
+    } else if (arg == "--workers") {
+      if (i == argc - 1) {
+        invalid_args(argv[0], "missing number of workers.");
+        return 1;
+      }
+      if (!parse_count(argv[i + 1], options.workers, MAX_THREADS) || options.workers == 0) {
+        invalid_args(argv[0], "invalid number of workers.");
+        return 1;
+      }
+      i += 1;
+    } else if (arg == "--ordered-output") {
+      options.ordered_output = true;
+    } else if (arg == "--paranoid-type-checks") {
+      options.cache.paranoid_typecode_checks = true;
+    } else if (arg == "--preload") {
+      options.preload = true;
+    } else if (arg == "--preload-threads") {
+      if (i == argc - 1) {
+        invalid_args(argv[0], "missing number of preload threads.");
+        return 1;
+      }
+      if (!parse_count(argv[i + 1], options.preload_threads, MAX_THREADS) || options.preload_threads == 0) {
+        invalid_args(argv[0], "invalid number of preload threads.");
+        return 1;
+      }
+      i += 1;
+    } else if (arg == "--negative-cache-ttl") {
+      if (i == argc - 1) {
+        invalid_args(argv[0], "missing negative cache TTL.");
+        return 1;
+      }
+      size_t ttl = 0;
+      if (!parse_count(argv[i + 1], ttl, MAX_TTL_SECONDS)) {
+        invalid_args(argv[0], "invalid negative cache TTL.");
+        return 1;
+      }
+      options.cache.negative_cache_ttl = std::chrono::seconds(ttl);
+      i += 1;
+    } else if (arg == "--catalog") {
+      if (i == argc - 1) {
+        invalid_args(argv[0], "missing catalog file.");
+        return 1;
+      }
+      options.cache.catalog_file = argv[i + 1];
+      i += 1;
+    } else if (arg == "--build-catalog") {
+      if (i == argc - 1) {
+        invalid_args(argv[0], "missing catalog file.");
+        return 1;
+      }
+      build_catalog = argv[i + 1];
+      i += 1;
+    } else if (arg == "--check-core-typecodes") {
+      check_core_typecodes = true;
+    } else if (arg == "--idl-file") {
+      if (i == argc - 1) {
+        invalid_args(argv[0], "missing IDL file.");
+        return 1;
+      }
+      options.idl_file = argv[i + 1];
+      i += 1;
+    } else if (arg == "--cache-file") {
+      if (i == argc - 1) {
+        invalid_args(argv[0], "missing cache file.");
+        return 1;
+      }
+      options.cache.cache_file = argv[i + 1];
+      i += 1;
+    } else if (arg == "--input-batch-size") {
+      if (i == argc - 1) {
+        invalid_args(argv[0], "missing batch size.");
+        return 1;
+      }
+      if (!parse_count(argv[i + 1], options.input_batch_size, MAX_BATCH_SIZE) ||
+        options.input_batch_size == 0)
+      {
+        invalid_args(argv[0], "invalid batch size.");
+        return 1;
+      }
+      i += 1;
     } else if (arg == "-W" || arg == "--swap-outputs") {
       output_options.swap_outputs = true;
       log_options.swap_outputs = true;
@@ -237,6 +449,10 @@ parse_args(
     }
   }
 
+  if (filter_at_source) {
+    input_options.raw_type_filter = options.raw_type_filter;
+  }
+
   // Normalize lists to contain unique entries
   unique_elements(participant_configs);
   unique_elements(input_options.input_files);
@@ -263,14 +479,49 @@ int main(int argc, const char ** const argv)
   BaseOutputEmitterOptions output_options;
   BaseTypeMonitorOptions options;
   std::vector<std::pair<const int32_t, const std::string>> participant_configs;
+  std::string build_catalog;
+  bool check_core_typecodes = false;
   rc = parse_args(argc, argv, participant_configs,
-    log_options, input_options, output_options, options);
+    log_options, input_options, output_options, options, build_catalog,
+    check_core_typecodes);
   if (-1 == rc) {
     return 0;
   } else if (0 != rc) {
     return rc;
   }
   log_init_default(log_options);
+  if (check_core_typecodes) {
+    try {
+      const std::vector<std::string> mismatched =
+        TypeCache::check_core_typecodes(options.cache);
+      if (!mismatched.empty()) {
+        LOG(ERROR) << mismatched.size() << " core typecodes don't match their type support" <<
+          std::endl;
+        return 1;
+      }
+    } catch (std::exception & e) {
+      LOG(ERROR) << "failed to check core typecodes: " << e.what() << std::endl;
+      return 1;
+    }
+    LOG(INFO) << "all core typecodes match their type support" << std::endl;
+    return 0;
+  }
+  if (!build_catalog.empty()) {
+    try {
+      TypeCacheOptions catalog_options = options.cache;
+      catalog_options.cache_file.clear();
+      catalog_options.catalog_file.clear();
+      TypeCache type_cache(catalog_options);
+      const size_t failed = type_cache.build_catalog(build_catalog);
+      if (failed > 0) {
+        LOG(WARNING) << failed << " types could not be added to the catalog" << std::endl;
+      }
+    } catch (std::exception & e) {
+      LOG(ERROR) << "failed to build catalog: " << e.what() << std::endl;
+      return -1;
+    }
+    return 0;
+  }
   try {
     if (participant_configs.size() == 0) {
       LOG(INFO) << "no DDS domains specified" << std::endl;
@@ -7,13 +7,17 @@
 // RTI is under no obligation to maintain or support the Software.  RTI shall
 // not be liable for any incidental or consequential damages arising out of the
 // use or inability to use the software.
+#include <sys/stat.h>
+
+#include <set>
 #include <string>
-#include <regex>
+#include <string_view>
 
+#include "robotspy/log.hpp"
 #include "robotspy/typesupport.hpp"
 
+#include "ament_index_cpp/get_resource.hpp"
 #include "ament_index_cpp/get_resources.hpp"
-#include "ament_index_cpp/get_package_prefix.hpp"
 #include "rcutils/error_handling.h"
 #include "rcutils/env.h"
 #include "rcpputils/shared_library.hpp"
@@ -32,85 +36,235 @@
 
 namespace robotspy
 {
+// Replace all (non-overlapping) occurrences of a pattern, scanning left to
+// right like std::regex_replace(). The replacement can't be longer than the
+// pattern, so the string is compacted in place.
+static
+void
+replace_all_inplace(std::string & str, const std::string_view & from, const std::string_view & to)
+{
+  size_t found = str.find(from.data(), 0, from.size());
+  if (found == std::string::npos) {
+    return;
+  }
+  size_t write_pos = found;
+  size_t read_pos = found;
+  while (found != std::string::npos) {
+    if (found > read_pos) {
+      str.replace(write_pos, found - read_pos, str, read_pos, found - read_pos);
+      write_pos += found - read_pos;
+    }
+    str.replace(write_pos, to.size(), to.data(), to.size());
+    write_pos += to.size();
+    read_pos = found + from.size();
+    found = str.find(from.data(), read_pos, from.size());
+  }
+  const size_t tail_len = str.size() - read_pos;
+  str.replace(write_pos, tail_len, str, read_pos, tail_len);
+  str.resize(write_pos + tail_len);
+}
+
+static
+bool
+ends_with(const std::string_view & str, const std::string_view & sfx)
+{
+  return str.size() >= sfx.size() &&
+         str.compare(str.size() - sfx.size(), sfx.size(), sfx) == 0;
+}
+
+bool
+scan_ros_type_name(const std::string_view & type_fqname, RosTypeNameComponents & components)
+{
+  components = RosTypeNameComponents();
+  // Names use either "::" or "/" as separator
+  const bool slash_sep = type_fqname.find('/') != std::string_view::npos;
+  const std::string_view sep = (slash_sep) ? "/" : "::";
+  const size_t first_sep = type_fqname.find(sep);
+  const size_t last_sep = type_fqname.rfind(sep);
+  if (first_sep == std::string_view::npos || first_sep == 0 ||
+    last_sep + sep.size() >= type_fqname.size())
+  {
+    return false;
+  }
+  components.package_name = type_fqname.substr(0, first_sep);
+  components.type_name = type_fqname.substr(last_sep + sep.size());
+  size_t middle_start = first_sep + sep.size();
+  size_t middle_end = last_sep;
+  // Strip the "dds[_]" namespace if it is the innermost one.
+  const size_t dds_pos = (middle_end > middle_start) ?
+    type_fqname.rfind(sep, middle_end - 1) : std::string_view::npos;
+  const size_t dds_start = (dds_pos == std::string_view::npos || dds_pos < first_sep) ?
+    first_sep + sep.size() : dds_pos + sep.size();
+  const std::string_view innermost =
+    type_fqname.substr(dds_start, (last_sep > dds_start) ? last_sep - dds_start : 0);
+  if (last_sep > first_sep && (innermost == "dds" || innermost == "dds_")) {
+    components.dds_namespace = true;
+    components.mangled = innermost == "dds_";
+    middle_end = (dds_start > middle_start) ? dds_start - sep.size() : middle_start;
+  }
+  if (middle_end > middle_start) {
+    components.middle_module = type_fqname.substr(middle_start, middle_end - middle_start);
+  }
+  if (components.mangled && components.type_name.back() == '_') {
+    components.type_name.remove_suffix(1);
+  }
+  if (components.type_name.empty()) {
+    return false;
+  }
+  if (ends_with(components.type_name, "Request")) {
+    components.request_reply = true;
+    components.is_request = true;
+  } else if (ends_with(components.type_name, "Response")) {
+    components.request_reply = true;
+  }
+  return true;
+}
+
 std::string
 normalize_dds_type_name(const std::string & type_fqname)
 {
-  const static std::regex double_underscore_re("__");
-  const static std::regex trail_underscore_re("_$");
-  const static std::regex dds_ns_re("::dds_::");
-  const static std::regex dds_ns_rm_re("::dds::");
   if (type_fqname.size() == 0) {
     throw std::runtime_error("empty type name");
   }
-  return
-    std::regex_replace(
-      std::regex_replace(
-        std::regex_replace(
-          std::regex_replace(
-            type_fqname,
-            double_underscore_re, "::"),
-          trail_underscore_re, ""),
-        dds_ns_re, "::dds::"),
-      dds_ns_rm_re, "::");
+  std::string result(type_fqname);
+  // "__" -> "::" doesn't change the length of the string.
+  size_t found = result.find("__");
+  while (found != std::string::npos) {
+    result[found] = ':';
+    result[found + 1] = ':';
+    found = result.find("__", found + 2);
+  }
+  if (result.back() == '_') {
+    result.pop_back();
+  }
+  if (result.find("::dds") != std::string::npos) {
+    replace_all_inplace(result, "::dds_::", "::dds::");
+    replace_all_inplace(result, "::dds::", "::");
+  }
+  return result;
 }
 
 const std::pair<bool, bool>
 is_type_requestreply(const std::string & type_fqname)
 {
-  size_t sfx_len = 8;
-  auto sfx_pos = type_fqname.rfind("Request_");
-  if (sfx_pos == std::string::npos) {
-    sfx_len = 7;
-    sfx_pos = type_fqname.rfind("Request");
-  }
-  if (sfx_pos == type_fqname.size() - sfx_len) {
+  const std::string_view name(type_fqname);
+  if (ends_with(name, "Request_") || ends_with(name, "Request")) {
     return {true, true};
   }
-
-  sfx_len = 9;
-  sfx_pos = type_fqname.rfind("Response_");
-  if (sfx_pos == std::string::npos) {
-    sfx_len = 8;
-    sfx_pos = type_fqname.rfind("Response");
-  }
-  if (sfx_pos == type_fqname.size() - sfx_len) {
+  if (ends_with(name, "Response_") || ends_with(name, "Response")) {
     return {true, false};
   }
-
   return {false, false};
 }
 
 const std::tuple<std::string, std::string, std::string>
 parse_ros_type_name(const std::string & type_fqname)
 {
-  const static std::regex double_underscore_re("__");
-  const static std::regex trail_underscore_re("_$");
-  std::string norm_fqname =
-    std::regex_replace(
-    std::regex_replace(type_fqname, double_underscore_re, "/"),
-    trail_underscore_re, "");
-  static const char type_separator = '/';
-  auto sep_position_back = norm_fqname.find_last_of(type_separator);
-  auto sep_position_front = norm_fqname.find_first_of(type_separator);
-  if (sep_position_back == std::string::npos ||
-    sep_position_back == 0 ||
-    sep_position_back == norm_fqname.length() - 1)
+  // Both "/" and "__" are accepted as separators. A trailing "_" is ignored
+  // when validating the name.
+  const std::string_view name(type_fqname);
+  const size_t norm_len = (name.size() > 0 && name.back() == '_') ?
+    name.size() - 1 : name.size();
+  size_t sep_front = std::string_view::npos;
+  size_t sep_front_len = 0;
+  size_t sep_back = std::string_view::npos;
+  size_t sep_back_len = 0;
+  for (size_t i = 0; i < norm_len; i++) {
+    size_t sep_len = 0;
+    if (name[i] == '/') {
+      sep_len = 1;
+    } else if (name[i] == '_' && i + 1 < name.size() && name[i + 1] == '_') {
+      sep_len = 2;
+    } else {
+      continue;
+    }
+    if (sep_front == std::string_view::npos) {
+      sep_front = i;
+      sep_front_len = sep_len;
+    }
+    sep_back = i;
+    sep_back_len = sep_len;
+    i += sep_len - 1;
+  }
+  if (sep_back == std::string_view::npos ||
+    sep_back == 0 ||
+    sep_back + sep_back_len >= norm_len)
   {
     throw InvalidTopicNameException(
       std::string("invalid ROS 2 type name: ") + type_fqname);
   }
 
-  std::string package_name = type_fqname.substr(0, sep_position_front);
-  std::string middle_module = "";
-  if (sep_position_back - sep_position_front > 0) {
-    middle_module =
-      type_fqname.substr(sep_position_front + 1, sep_position_back - sep_position_front - 1);
+  std::string package_name(name.substr(0, sep_front));
+  std::string middle_module;
+  if (sep_back > sep_front) {
+    middle_module = name.substr(sep_front + sep_front_len, sep_back - sep_front - sep_front_len);
   }
-  std::string type_name = type_fqname.substr(sep_position_back + 1);
+  std::string type_name(name.substr(sep_back + sep_back_len));
 
   return std::make_tuple(package_name, middle_module, type_name);
 }
 
+std::string
+demangle_dds_type_name(const std::string & dds_type_name)
+{
+  const std::string_view name(dds_type_name);
+  // Check if the name is already in "canonical" ROS 2 form
+  // i.e. <package>::(msg|srv)::<type>
+  const size_t first_sep_pos = name.find("::");
+  const size_t last_sep_pos = name.rfind("::");
+  if (first_sep_pos != std::string_view::npos &&
+    last_sep_pos == first_sep_pos + 5 &&
+    (name.compare(first_sep_pos, 7, "::msg::") == 0 ||
+    name.compare(first_sep_pos, 7, "::srv::") == 0))
+  {
+    std::string result;
+    result.reserve(name.size() - 2);
+    result.append(name.substr(0, first_sep_pos));
+    result.append("/");
+    result.append(name.substr(first_sep_pos + 2, 3));
+    result.append("/");
+    result.append(name.substr(last_sep_pos + 2));
+    return result;
+  }
+
+  size_t dds_prefix_len = 8;
+  auto dds_prefix_pos = name.rfind("::dds_::");
+  if (dds_prefix_pos == std::string_view::npos) {
+    dds_prefix_len -= 1;
+    dds_prefix_pos = name.rfind("::dds::");
+    if (dds_prefix_pos == std::string_view::npos) {
+      throw InvalidTopicNameException(
+        std::string("invalid ROS 2 DDS type name 1: ") + dds_type_name);
+    }
+  }
+  // Check that there aren't more "::" after "dds[_]::"
+  if (last_sep_pos != (dds_prefix_pos + dds_prefix_len - 2)) {
+    throw InvalidTopicNameException(
+        std::string("invalid ROS 2 DDS type name 2: ") + dds_type_name);
+  }
+
+  std::string_view type_name = name.substr(dds_prefix_pos + dds_prefix_len);
+  if (type_name.size() > 0 && type_name.back() == '_') {
+    type_name.remove_suffix(1);
+  }
+
+  // Join all namespaces before "dds[_]" with "/"
+  std::string result;
+  result.reserve(name.size());
+  std::string_view modules = name.substr(0, dds_prefix_pos);
+  size_t sep_pos = modules.find("::");
+  while (sep_pos != std::string_view::npos) {
+    result.append(modules.substr(0, sep_pos));
+    result.append("/");
+    modules.remove_prefix(sep_pos + 2);
+    sep_pos = modules.find("::");
+  }
+  result.append(modules);
+  result.append("/");
+  result.append(type_name);
+  return result;
+}
+
 void
 get_library_path(std::vector<std::string> & library_path)
 {
@@ -160,8 +314,8 @@ lookup_introspection_typesupport(
   auto symbol_name = typesupport_identifier + "__get_message_type_support_handle__" +
     package_name + "__" + (middle_module.empty() ? "msg" : middle_module) + "__" + type_name;
 
-  if (!typesupport_lib.get_symbol(symbol_name)) {
-    throw std::runtime_error("symbol not found");
+  if (!typesupport_lib.has_symbol(symbol_name)) {
+    throw TypesupportNotFoundException("symbol not found: " + symbol_name);
   }
 
   const rosidl_message_type_support_t * (* get_ts)() = nullptr;
@@ -174,15 +328,76 @@ lookup_introspection_typesupport(
   return type_support;
 }
 
-std::tuple<
-  bool,
-  std::shared_ptr<rcpputils::SharedLibrary>,
-  const rosidl_message_type_support_t *>
-load_instrospection_typesupport_library(
-  const std::string & package_name,
-  const std::string & middle_module,
-  const std::string & type_name,
-  const std::vector<std::string> & library_path)
+std::vector<std::string>
+get_installed_ros_types()
+{
+  std::vector<std::string> types;
+  for (auto & resource : ament_index_cpp::get_resources("rosidl_interfaces")) {
+    const std::string & package_name = resource.first;
+    std::string content;
+    if (!ament_index_cpp::get_resource("rosidl_interfaces", package_name, content)) {
+      continue;
+    }
+    // Each line is the path of an interface file relative to the package's
+    // share directory, e.g. "msg/String.idl". Interfaces are usually listed
+    // once per file format.
+    std::set<std::string> package_types;
+    size_t line_start = 0;
+    while (line_start < content.size()) {
+      size_t line_end = content.find('\n', line_start);
+      if (std::string::npos == line_end) {
+        line_end = content.size();
+      }
+      std::string_view line(content.data() + line_start, line_end - line_start);
+      line_start = line_end + 1;
+      if (line.size() > 0 && line.back() == '\r') {
+        line.remove_suffix(1);
+      }
+      const size_t sep = line.find('/');
+      const size_t ext = line.rfind('.');
+      if (std::string_view::npos == sep || std::string_view::npos == ext || ext <= sep + 1) {
+        continue;
+      }
+      const std::string_view kind = line.substr(0, sep);
+      const std::string name(line.substr(sep + 1, ext - sep - 1));
+      if (kind == "msg") {
+        package_types.insert(package_name + "::msg::" + name);
+      } else if (kind == "srv") {
+        package_types.insert(package_name + "::srv::" + name + "_Request");
+        package_types.insert(package_name + "::srv::" + name + "_Response");
+      }
+    }
+    types.insert(types.end(), package_types.begin(), package_types.end());
+  }
+  return types;
+}
+
+TypesupportLibraryResolver::TypesupportLibraryResolver(
+  const std::chrono::steady_clock::duration negative_ttl)
+: TypesupportLibraryResolver(
+    []() {
+      std::vector<std::string> library_path;
+      get_library_path(library_path);
+      return library_path;
+    }(),
+    negative_ttl)
+{}
+
+TypesupportLibraryResolver::TypesupportLibraryResolver(
+  const std::vector<std::string> & library_path,
+  const std::chrono::steady_clock::duration negative_ttl)
+: library_path_(library_path),
+  negative_ttl_(negative_ttl)
+{
+  for (auto & resource : ament_index_cpp::get_resources("rosidl_interfaces")) {
+    package_prefixes_.emplace(resource.first, resource.second);
+  }
+  LOG(DEBUG) << "found " << package_prefixes_.size() <<
+    " interface packages in ament index" << std::endl;
+}
+
+std::vector<TypesupportLibraryResolver::Library>
+TypesupportLibraryResolver::resolve(const std::string & package_name)
 {
 #ifdef _WIN32
   static const std::string dynamic_library_folder = "/bin/";
@@ -199,40 +414,84 @@ load_instrospection_typesupport_library(
 #endif
   static const std::vector<std::string> intro_langs = {"c", "cpp"};
 
-  std::vector<std::string> package_prefixes;
+  const auto now = std::chrono::steady_clock::now();
+  std::lock_guard<std::mutex> lock(resolved_mutex_);
+  auto cached = resolved_.find(package_name);
+  if (resolved_.end() != cached) {
+    if (!cached->second.libraries.empty()) {
+      return cached->second.libraries;
+    }
+    if (now - cached->second.timestamp < negative_ttl_) {
+      negative_hits_ += 1;
+      return cached->second.libraries;
+    }
+  }
 
-  std::ostringstream ss;
-  try {
-    package_prefixes.emplace_back(
-      ament_index_cpp::get_package_prefix(package_name));
-  } catch (ament_index_cpp::PackageNotFoundError & e) {
-    // TODO log ?
-  }
-  package_prefixes.insert(
-    std::end(package_prefixes), std::begin(library_path), std::end(library_path));
-  if (package_prefixes.size() == 0) {
-    throw std::runtime_error("no directory in library search path");
-  }
-  for (const auto & pkg_prefix : package_prefixes) {
-    for (const auto & intro_lang: intro_langs) {
-      ss.clear();
-      ss << pkg_prefix << dynamic_library_folder <<
-        filename_prefix << package_name << "__" <<
-        "rosidl_typesupport_introspection" << "_" << intro_lang <<
-        filename_extension;
-      try {
-        std::shared_ptr<rcpputils::SharedLibrary> shared_lib =
-          std::make_shared<rcpputils::SharedLibrary>(ss.str());
-        bool shared_lib_cpp = intro_lang == "cpp";
-        auto type_support = lookup_introspection_typesupport(
-          package_name, middle_module, type_name, *shared_lib, shared_lib_cpp);
-        return std::make_tuple(shared_lib_cpp, shared_lib, type_support);
-      } catch (std::exception & e) {
-        // TODO(asorbini) log exception ?
+  // Directories containing the package's libraries, in order of preference.
+  std::vector<std::string> lib_dirs;
+  auto indexed = package_prefixes_.find(package_name);
+  if (package_prefixes_.end() != indexed) {
+    lib_dirs.emplace_back(indexed->second + dynamic_library_folder);
+  }
+  for (const auto & dir : library_path_) {
+    lib_dirs.emplace_back(dir + "/");
+  }
+
+  std::vector<Library> libraries;
+  for (const auto & intro_lang : intro_langs) {
+    const std::string filename = filename_prefix + package_name + "__" +
+      "rosidl_typesupport_introspection_" + intro_lang + filename_extension;
+    for (const auto & lib_dir : lib_dirs) {
+      Library lib;
+      lib.path = lib_dir + filename;
+      struct stat lib_stat;
+      if (0 != stat(lib.path.c_str(), &lib_stat) || !S_ISREG(lib_stat.st_mode)) {
+        continue;
       }
+      lib.cpp_version = intro_lang == "cpp";
+      lib.mtime = static_cast<int64_t>(lib_stat.st_mtime);
+      lib.size = static_cast<uint64_t>(lib_stat.st_size);
+      libraries.push_back(std::move(lib));
+      break;
     }
   }
-  throw std::runtime_error("failed to load typesupport");
+  if (libraries.empty()) {
+    LOG(DEBUG) << "no type support library found for package: " << package_name << std::endl;
+  }
+  Resolved & resolved = resolved_[package_name];
+  resolved.libraries = libraries;
+  resolved.timestamp = now;
+  return libraries;
+}
+
+std::string
+TypesupportLibraryResolver::installed_version(const std::string & package_name)
+{
+  std::ostringstream ss;
+  for (const auto & lib : resolve(package_name)) {
+    ss << lib.path << ":" << lib.mtime << ":" << lib.size << ";";
+  }
+  return ss.str();
+}
+
+std::vector<std::pair<bool, std::shared_ptr<rcpputils::SharedLibrary>>>
+open_introspection_typesupport_libraries(
+  const std::string & package_name,
+  TypesupportLibraryResolver & resolver)
+{
+  std::vector<std::pair<bool, std::shared_ptr<rcpputils::SharedLibrary>>> opened;
+  for (const auto & lib : resolver.resolve(package_name)) {
+    try {
+      opened.emplace_back(lib.cpp_version, std::make_shared<rcpputils::SharedLibrary>(lib.path));
+    } catch (std::exception & e) {
+      LOG(DEBUG) << "failed to load type support library " << lib.path << ": " <<
+        e.what() << std::endl;
+    }
+  }
+  if (opened.empty()) {
+    throw TypesupportNotFoundException("failed to load type support for package: " + package_name);
+  }
+  return opened;
 }
 
 std::pair<bool, const rosidl_message_type_support_t *>